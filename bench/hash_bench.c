@@ -0,0 +1,137 @@
+// string hashing and comparison speed in bytes per cycle, from the repo root:
+// cc -O2 -I. -o hash_bench bench/hash_bench.c $(ls *.c | grep -v main.c) -lm
+//
+// "before" is the byte at a time FNV-1a hash and memcmp that hashString
+// and charsEqual replaced, both are run on the same buffers
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "object.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CLOCK_UNIT "cycle"
+#else
+#define CLOCK_UNIT "ns"
+#endif
+
+#define BUFFER_SIZE (1 << 20)
+#define BYTES_PER_RUN (64 << 20)
+#define RUNS 5
+
+// timestamp counter where there is one, nanoseconds otherwise
+static unsigned long long ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (unsigned long long)time.tv_sec * 1000000000ull + time.tv_nsec;
+#endif
+}
+
+// the hash strings used before
+static uint32_t hashFnv(const char *key, int length)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static bool memcmpEqual(const char *a, const char *b, int length)
+{
+    return memcmp(a, b, length) == 0;
+}
+
+static char *first;
+static char *second;
+static volatile uint32_t sink;
+
+// best bytes per tick over a few runs, starting points move
+// around so each call doesn't see the exact same bytes
+static double measureHash(uint32_t (*hash)(const char *, int), int length)
+{
+    long calls = BYTES_PER_RUN / length;
+    double best = 0;
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        uint32_t sum = 0;
+        unsigned long long start = ticks();
+
+        for (long i = 0; i < calls; i++)
+            sum += hash(first + (i & 255), length);
+
+        double rate = (double)calls * length / (ticks() - start);
+        if (rate > best)
+            best = rate;
+
+        sink = sum;
+    }
+
+    return best;
+}
+
+// equal strings so every byte is compared
+static double measureEqual(bool (*equal)(const char *, const char *, int), int length)
+{
+    long calls = BYTES_PER_RUN / length;
+    double best = 0;
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        uint32_t sum = 0;
+        unsigned long long start = ticks();
+
+        for (long i = 0; i < calls; i++)
+            sum += equal(first + (i & 255), second + (i & 255), length);
+
+        double rate = (double)calls * length / (ticks() - start);
+        if (rate > best)
+            best = rate;
+
+        sink = sum;
+    }
+
+    return best;
+}
+
+int main()
+{
+    static const int lengths[] = {8, 16, 32, 64, 256, 4096, 65536};
+
+    first = malloc(BUFFER_SIZE);
+    second = malloc(BUFFER_SIZE);
+    if (first == NULL || second == NULL)
+        return 1;
+
+    srand(1);
+    for (int i = 0; i < BUFFER_SIZE; i++)
+        first[i] = (char)rand();
+    memcpy(second, first, BUFFER_SIZE);
+
+    printf("bytes per %s\n", CLOCK_UNIT);
+    printf("%8s %10s %10s %10s %10s\n", "length", "fnv-1a", "hashString", "memcmp", "charsEqual");
+
+    for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++)
+    {
+        int length = lengths[i];
+        printf("%8d %10.2f %10.2f %10.2f %10.2f\n", length,
+               measureHash(hashFnv, length), measureHash(hashString, length),
+               measureEqual(memcmpEqual, length), measureEqual(charsEqual, length));
+    }
+
+    free(first);
+    free(second);
+    return 0;
+}
@@ -0,0 +1,125 @@
+// open addressing probes indexed by modulo and by mask, from the repo root:
+// cc -O2 -o probe_bench bench/probe_bench.c
+//
+// capacities are powers of two so both find the same slots, modulo
+// is what tables did before and costs a division per probe
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_KEYS 1000000
+#define LOOKUPS 20000000
+#define RUNS 5
+
+// slots hold a key's hash, 0 is empty
+static uint32_t *slots;
+static uint32_t keys[MAX_KEYS];
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+// spread the bits of i over a nonzero hash
+static uint32_t hashOf(uint32_t i)
+{
+    i ^= i >> 16;
+    i *= 0x7feb352d;
+    i ^= i >> 15;
+    i *= 0x846ca68b;
+    i ^= i >> 16;
+    return i == 0 ? 1 : i;
+}
+
+static void insert(uint32_t hash, uint32_t capacity)
+{
+    uint32_t index = hash & (capacity - 1);
+    while (slots[index] != 0)
+        index = (index + 1) & (capacity - 1);
+    slots[index] = hash;
+}
+
+// noinline keeps the compiler from learning the capacity
+__attribute__((noinline)) static uint32_t probeModulo(uint32_t capacity, int count)
+{
+    uint32_t found = 0;
+    for (long i = 0; i < LOOKUPS; i++)
+    {
+        uint32_t hash = keys[(i * 7919) % count];
+        uint32_t index = hash % capacity;
+        while (slots[index] != hash)
+            index = (index + 1) % capacity;
+        found += index;
+    }
+    return found;
+}
+
+__attribute__((noinline)) static uint32_t probeMask(uint32_t capacity, int count)
+{
+    uint32_t mask = capacity - 1;
+    uint32_t found = 0;
+    for (long i = 0; i < LOOKUPS; i++)
+    {
+        uint32_t hash = keys[(i * 7919) % count];
+        uint32_t index = hash & mask;
+        while (slots[index] != hash)
+            index = (index + 1) & mask;
+        found += index;
+    }
+    return found;
+}
+
+// best ns per lookup over a few runs
+static double measure(uint32_t (*probe)(uint32_t, int), uint32_t capacity, int count)
+{
+    double best = 1e18;
+    volatile uint32_t sink = 0;
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        double start = now();
+        sink += probe(capacity, count);
+
+        double elapsed = (now() - start) / LOOKUPS;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+int main()
+{
+    printf("%8s %10s %10s %10s\n", "keys", "capacity", "modulo", "mask");
+
+    for (int count = 1000; count <= MAX_KEYS; count *= 10)
+    {
+        // smallest power of two that keeps the table 75% full at most
+        uint32_t capacity = 8;
+        while (count > capacity * 3 / 4)
+            capacity *= 2;
+
+        slots = calloc(capacity, sizeof(uint32_t));
+        if (slots == NULL)
+            return 1;
+
+        for (int i = 0; i < count; i++)
+        {
+            keys[i] = hashOf((uint32_t)i);
+            insert(keys[i], capacity);
+        }
+
+        printf("%8d %10u %7.1f ns %7.1f ns\n", count, capacity,
+               measure(probeModulo, capacity, count), measure(probeMask, capacity, count));
+
+        free(slots);
+    }
+
+    return 0;
+}
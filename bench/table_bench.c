@@ -0,0 +1,104 @@
+// table lookups at growing sizes, hits and misses, from the repo root:
+// cc -O2 -I. -o table_bench bench/table_bench.c $(ls *.c | grep -v main.c) -lm
+//
+// "throughput" runs independent lookups so the cpu can overlap their
+// misses, "latency" makes each key depend on the last lookup so every
+// miss on the way to the value is paid in full
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+#define MAX_KEYS 1000000
+#define LOOKUPS 2000000
+#define RUNS 5
+
+static ObjString *keys[MAX_KEYS];
+static ObjString *missing[MAX_KEYS];
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+// best ns per lookup over a few runs, keys are visited in a
+// stride that jumps around the table
+static double measure(Table *table, ObjString **from, int count, bool isChained)
+{
+    double best = 1e18;
+    double sum = 0;
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        long index = run;
+        double start = now();
+
+        for (long i = 0; i < LOOKUPS; i++)
+        {
+            Value value = NUMBER_VAL(0);
+            bool found = tableGet(table, from[index], &value);
+            sum += AS_NUMBER(value);
+
+            // the chained walk can't start on the next key until this
+            // lookup has its answer, the step is always 7919 but the
+            // cpu can't know that before the loads arrive
+            long step = 7919;
+            if (isChained)
+                step += (AS_NUMBER(value) < 0) + (found != (from == keys));
+
+            index = (index + step) % count;
+        }
+
+        double elapsed = (now() - start) / LOOKUPS;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    // keep the lookups from being thrown away
+    if (sum == -1)
+        printf("%g\n", sum);
+
+    return best;
+}
+
+int main()
+{
+    initVM();
+
+    char buffer[32];
+    for (int i = 0; i < MAX_KEYS; i++)
+    {
+        int length = snprintf(buffer, sizeof(buffer), "key%d", i);
+        keys[i] = copyString(buffer, length);
+
+        length = snprintf(buffer, sizeof(buffer), "missing%d", i);
+        missing[i] = copyString(buffer, length);
+    }
+
+    printf("%8s %12s %12s %12s %12s\n", "keys", "hit", "miss", "hit chained", "miss chained");
+
+    for (int count = 1000; count <= MAX_KEYS; count *= 10)
+    {
+        Table table;
+        initTable(&table);
+
+        for (int i = 0; i < count; i++)
+            tableSet(&table, keys[i], NUMBER_VAL(i));
+
+        printf("%8d %9.1f ns %9.1f ns %9.1f ns %9.1f ns\n", count,
+               measure(&table, keys, count, false), measure(&table, missing, count, false),
+               measure(&table, keys, count, true), measure(&table, missing, count, true));
+
+        freeTable(&table);
+    }
+
+    freeVM();
+    return 0;
+}
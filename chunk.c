@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "chunk.h"
 #include "memory.h"
@@ -10,14 +11,20 @@ void initChunk(Chunk *chunk)
     chunk->capacity = 0;
     chunk->code = NULL;
     chunk->lines = NULL;
+    chunk->arena = NULL;
+    chunk->isPacked = false;
     initValueArray(&chunk->constants);
 }
 
-// empty chunk of code
+// empty chunk of code, arenas and code segments free their own memory
 void freeChunk(Chunk *chunk)
 {
-    FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
-    FREE_ARRAY(int, chunk->lines, chunk->capacity);
+    if (chunk->arena == NULL && !chunk->isPacked)
+    {
+        FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
+        FREE_ARRAY(int, chunk->lines, chunk->capacity);
+    }
+
     freeValueArray(&chunk->constants);
     initChunk(chunk);
 }
@@ -29,9 +36,21 @@ void writeChunk(Chunk *chunk, uint8_t byte, int line)
     if (chunk->capacity < chunk->count + 1)
     {
         int oldCapacity = chunk->capacity;
-        chunk->capacity = GROW_CAPACITY(oldCapacity);
-        chunk->code = GROW_ARRAY(uint8_t, chunk->code, oldCapacity, chunk->capacity);
-        chunk->lines = GROW_ARRAY(int, chunk->lines, oldCapacity, chunk->capacity);
+        int capacity = GROW_CAPACITY(oldCapacity);
+
+        if (chunk->arena != NULL)
+        {
+            chunk->code = GROW_SCRATCH(chunk->arena, uint8_t, chunk->code, oldCapacity, capacity);
+            chunk->lines = GROW_SCRATCH(chunk->arena, int, chunk->lines, oldCapacity, capacity);
+        }
+        else
+        {
+            chunk->code = GROW_ARRAY(uint8_t, chunk->code, oldCapacity, capacity);
+            chunk->lines = GROW_ARRAY(int, chunk->lines, oldCapacity, capacity);
+        }
+
+        // only once the arrays exist, growing can jump out on oom
+        chunk->capacity = capacity;
     }
 
     // append bytecode, lines, and increment count
@@ -45,4 +64,56 @@ int addConstant(Chunk *chunk, Value value)
 {
     writeArrayValue(&chunk->constants, value);
     return chunk->constants.count - 1;
+}
+
+// pack finished chunks into one segment
+CodeSegment *packChunks(Chunk *chunks[], int count)
+{
+    size_t codeSize = 0;
+    for (int i = 0; i < count; i++)
+        codeSize += chunks[i]->count;
+
+    // lines go after all of the code, aligned for ints
+    size_t linesOffset = (codeSize + sizeof(int) - 1) & ~(sizeof(int) - 1);
+    size_t size = linesOffset + (codeSize * sizeof(int));
+
+    CodeSegment *segment = (CodeSegment *)reallocate(NULL, 0, sizeof(CodeSegment) + size);
+    segment->next = NULL;
+    segment->size = size;
+
+    uint8_t *code = segment->bytes;
+    int *lines = (int *)(segment->bytes + linesOffset);
+
+    for (int i = 0; i < count; i++)
+    {
+        Chunk *chunk = chunks[i];
+
+        memcpy(code, chunk->code, chunk->count);
+        memcpy(lines, chunk->lines, sizeof(int) * chunk->count);
+
+        // old arrays belong to an arena or the heap
+        if (chunk->arena == NULL && !chunk->isPacked)
+        {
+            FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
+            FREE_ARRAY(int, chunk->lines, chunk->capacity);
+        }
+
+        chunk->code = code;
+        chunk->lines = lines;
+        chunk->capacity = chunk->count;
+        chunk->arena = NULL;
+        chunk->isPacked = true;
+        shrinkValueArray(&chunk->constants);
+
+        code += chunk->count;
+        lines += chunk->count;
+    }
+
+    return segment;
+}
+
+// free a segment
+void freeCodeSegment(CodeSegment *segment)
+{
+    reallocate(segment, sizeof(CodeSegment) + segment->size, 0);
 }
\ No newline at end of file
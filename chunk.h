@@ -28,6 +28,13 @@ typedef enum
     OP_NOT,
     OP_NEGATE,
     OP_PRINT,
+    OP_BUILD_STRING,
+    OP_MAP,
+    OP_MAP_ADD,
+    OP_LIST,
+    OP_LIST_ADD,
+    OP_GET_INDEX,
+    OP_SET_INDEX,
     OP_JUMP,
     OP_JUMP_IF_FALSE,
     OP_LOOP,
@@ -52,8 +59,23 @@ typedef struct
 
     // array of literal values
     ValueArray constants;
+
+    // arena code and lines grow in while compiling, NULL otherwise
+    ScratchArena *arena;
+
+    // code and lines live in a shared code segment
+    bool isPacked;
 } Chunk;
 
+// finished code of every function from one compile, packed
+// back to back so calls between them stay close in cache
+typedef struct CodeSegment
+{
+    struct CodeSegment *next;
+    size_t size;
+    uint8_t bytes[];
+} CodeSegment;
+
 // create chunk
 void initChunk(Chunk *chunk);
 
@@ -66,4 +88,11 @@ void writeChunk(Chunk *chunk, uint8_t byte, int line);
 // add literal value
 int addConstant(Chunk *chunk, Value value);
 
+// move chunks into one exactly sized segment: all of the code,
+// then all of the lines, and shrink their constants
+CodeSegment *packChunks(Chunk *chunks[], int count);
+
+// free a segment, its chunks can't be used after
+void freeCodeSegment(CodeSegment *segment);
+
 #endif
\ No newline at end of file
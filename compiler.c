@@ -4,6 +4,7 @@
 
 #include "common.h"
 #include "compiler.h"
+#include "memory.h"
 #include "scanner.h"
 
 #ifdef DEBUG_PRINT_CODE
@@ -75,6 +76,19 @@ Parser parser;
 Compiler *current = NULL;
 Chunk *compilingChunk;
 
+// scratch memory for chunks while they're being written
+ScratchArena scratch;
+
+// every function finished during this compile, packed at the end
+typedef struct
+{
+    Chunk **chunks;
+    int count;
+    int capacity;
+} CompiledChunks;
+
+CompiledChunks compiled;
+
 // the chunk of the function we're compiling: main or user def.
 static Chunk *currentChunk()
 {
@@ -261,6 +275,8 @@ static void initCompiler(Compiler *compiler, FunctionType type)
     compiler->localCount = 0;
     compiler->scopeDepth = 0;
     compiler->function = newFunction();
+    compiler->function->chunk.arena = &scratch;
+    compiler->function->chunk.constants.arena = &scratch;
     current = compiler;
 
     if (type != TYPE_SCRIPT)
@@ -282,6 +298,16 @@ static ObjFunction *endCompiler()
 
     ObjFunction *function = current->function;
 
+    // remember the chunk so it can be packed once compiling is done
+    if (compiled.capacity < compiled.count + 1)
+    {
+        int oldCapacity = compiled.capacity;
+        int capacity = GROW_CAPACITY(oldCapacity);
+        compiled.chunks = GROW_SCRATCH(&scratch, Chunk *, compiled.chunks, oldCapacity, capacity);
+        compiled.capacity = capacity;
+    }
+    compiled.chunks[compiled.count++] = &function->chunk;
+
 #ifdef DEBUG_PRINT_CODE
     if (!parser.hadError)
     {
@@ -410,12 +436,90 @@ static void grouping(bool canAssign)
     consume(TOKEN_RIGHT_PAREN, "Expecting ')' after expression.");
 }
 
-// convert string token to number
-// todo: fix whacky stuff i did with numbers
+// map literal, {key: value, ...}; pairs are pushed and added to
+// the map in batches so literals aren't limited to one operand byte
+static void mapLiteral(bool canAssign)
+{
+    emitByte(OP_MAP);
+
+    int pending = 0;
+    if (!check(TOKEN_RIGHT_BRACE))
+    {
+        do
+        {
+            // trailing comma
+            if (check(TOKEN_RIGHT_BRACE))
+                break;
+
+            expression();
+            consume(TOKEN_COLON, "Expected ':' after map key.");
+            expression();
+
+            if (++pending == UINT8_MAX)
+            {
+                emitBytes(OP_MAP_ADD, (uint8_t)pending);
+                pending = 0;
+            }
+        } while (match(TOKEN_COMMA));
+    }
+
+    consume(TOKEN_RIGHT_BRACE, "Expected '}' after map entries.");
+
+    if (pending > 0)
+        emitBytes(OP_MAP_ADD, (uint8_t)pending);
+}
+
+// list literal, [a, b, ...]; elements are added in batches like map pairs
+static void listLiteral(bool canAssign)
+{
+    emitByte(OP_LIST);
+
+    int pending = 0;
+    if (!check(TOKEN_RIGHT_BRACKET))
+    {
+        do
+        {
+            // trailing comma
+            if (check(TOKEN_RIGHT_BRACKET))
+                break;
+
+            expression();
+
+            if (++pending == UINT8_MAX)
+            {
+                emitBytes(OP_LIST_ADD, (uint8_t)pending);
+                pending = 0;
+            }
+        } while (match(TOKEN_COMMA));
+    }
+
+    consume(TOKEN_RIGHT_BRACKET, "Expected ']' after list elements.");
+
+    if (pending > 0)
+        emitBytes(OP_LIST_ADD, (uint8_t)pending);
+}
+
+// index into a value, target[key] or target[key] = value
+static void subscript(bool canAssign)
+{
+    expression();
+    consume(TOKEN_RIGHT_BRACKET, "Expected ']' after index.");
+
+    if (canAssign && match(TOKEN_EQUAL))
+    {
+        expression();
+        emitByte(OP_SET_INDEX);
+    }
+    else
+    {
+        emitByte(OP_GET_INDEX);
+    }
+}
+
+// number token, the scanner already parsed its value
 static void number(bool canAssign)
 {
-    double value = strtod(parser.previous.start, NULL);
-    emitConstant(NUMBER_VAL(value));
+    emitConstant(NUMBER_VAL(parser.previous.number));
 }
 
 // short circuit or
@@ -435,7 +539,43 @@ static void or_(bool canAssign)
 static void string(bool canAssign)
 {
     // the +1 and -2 trim the quotation marks
-    emitConstant(OBJ_VAL(copyString(parser.previous.start + 1, parser.previous.length - 2)));
+    emitConstant(sourceText(parser.previous.start + 1, parser.previous.length - 2));
+}
+
+// interpolated string, each literal part and ${ } expression is
+// pushed then OP_BUILD_STRING joins them into one string
+static void interpolation(bool canAssign)
+{
+    int count = 0;
+
+    do
+    {
+        // literal before the ${, trims the opening " or } and the ${
+        if (parser.previous.length > 3)
+        {
+            emitConstant(sourceText(parser.previous.start + 1, parser.previous.length - 3));
+            count++;
+        }
+
+        expression();
+        count++;
+    } while (match(TOKEN_INTERPOLATION));
+
+    // rest of the string after the last }
+    consume(TOKEN_STRING, "Expected end of string interpolation.");
+    if (parser.previous.length > 2)
+    {
+        emitConstant(sourceText(parser.previous.start + 1, parser.previous.length - 2));
+        count++;
+    }
+
+    if (count > UINT8_MAX)
+    {
+        error("Too many parts in one interpolated string.");
+        return;
+    }
+
+    emitBytes(OP_BUILD_STRING, (uint8_t)count);
 }
 
 static void namedVariable(Token variable, bool canAssign)
@@ -683,9 +823,12 @@ static void and_(bool canAssign)
 ParseRule rules[] = {
     [TOKEN_LEFT_PAREN] = {grouping, call, PREC_CALL},
     [TOKEN_RIGHT_PAREN] = {NULL, NULL, PREC_NONE},
-    [TOKEN_LEFT_BRACE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_LEFT_BRACE] = {mapLiteral, NULL, PREC_NONE},
     [TOKEN_RIGHT_BRACE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_LEFT_BRACKET] = {listLiteral, subscript, PREC_CALL},
+    [TOKEN_RIGHT_BRACKET] = {NULL, NULL, PREC_NONE},
     [TOKEN_COMMA] = {NULL, NULL, PREC_NONE},
+    [TOKEN_COLON] = {NULL, NULL, PREC_NONE},
     [TOKEN_DOT] = {NULL, NULL, PREC_NONE},
     [TOKEN_MINUS] = {unary, binary, PREC_TERM},
     [TOKEN_PLUS] = {NULL, binary, PREC_TERM},
@@ -703,6 +846,7 @@ ParseRule rules[] = {
     [TOKEN_LESS_EQUAL] = {NULL, binary, PREC_COMPARISON},
     [TOKEN_IDENTIFIER] = {variable, NULL, PREC_NONE},
     [TOKEN_STRING] = {string, NULL, PREC_NONE},
+    [TOKEN_INTERPOLATION] = {interpolation, NULL, PREC_NONE},
     [TOKEN_NUMBER] = {number, NULL, PREC_NONE},
     [TOKEN_AND] = {NULL, and_, PREC_AND},
     [TOKEN_CLASS] = {NULL, NULL, PREC_NONE},
@@ -1118,6 +1262,15 @@ ObjFunction *compile(const char *source)
 {
     // make a scanner to generate tokens from code
     initScanner(source);
+
+    // a compile that ran out of memory may have left these behind,
+    // its chunks still point at the arena so they never free from it
+    current = NULL;
+    freeScratchArena(&scratch);
+    compiled.chunks = NULL;
+    compiled.count = 0;
+    compiled.capacity = 0;
+
     Compiler compiler;
     initCompiler(&compiler, TYPE_SCRIPT);
 
@@ -1136,5 +1289,25 @@ ObjFunction *compile(const char *source)
 
     // finished compiling chunk
     ObjFunction *function = endCompiler();
-    return !parser.hadError ? NULL : function;
+
+    if (parser.hadError)
+    {
+        // nothing will run, drop the half written chunks
+        for (int i = 0; i < compiled.count; i++)
+            freeChunk(compiled.chunks[i]);
+    }
+    else
+    {
+        // shrink and pack every function's code together
+        CodeSegment *segment = packChunks(compiled.chunks, compiled.count);
+        segment->next = vm.code;
+        vm.code = segment;
+    }
+
+    freeScratchArena(&scratch);
+    compiled.chunks = NULL;
+    compiled.count = 0;
+    compiled.capacity = 0;
+
+    return parser.hadError ? NULL : function;
 }
\ No newline at end of file
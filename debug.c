@@ -1,6 +1,7 @@
 #include <stdio.h>
 
 #include "debug.h"
+#include "table.h"
 #include "value.h"
 
 // go through bytecode array in chunk
@@ -102,6 +103,20 @@ int disassembleInstruction(Chunk *chunk, int offset)
         return simpleInstruction("OP_NEGATE", offset);
     case OP_PRINT:
         return simpleInstruction("OP_PRINT", offset);
+    case OP_BUILD_STRING:
+        return byteInstruction("OP_BUILD_STRING", chunk, offset);
+    case OP_MAP:
+        return simpleInstruction("OP_MAP", offset);
+    case OP_MAP_ADD:
+        return byteInstruction("OP_MAP_ADD", chunk, offset);
+    case OP_LIST:
+        return simpleInstruction("OP_LIST", offset);
+    case OP_LIST_ADD:
+        return byteInstruction("OP_LIST_ADD", chunk, offset);
+    case OP_GET_INDEX:
+        return simpleInstruction("OP_GET_INDEX", offset);
+    case OP_SET_INDEX:
+        return simpleInstruction("OP_SET_INDEX", offset);
     case OP_JUMP:
         return jumpInstruction("OP_JUMP", 1, chunk, offset);
     case OP_JUMP_IF_FALSE:
@@ -131,4 +146,14 @@ void printStack(Value stack[], Value *stackTop)
     }
 
     printf("\n");
-}
\ No newline at end of file
+}
+
+// print a table's shape and probe lengths
+void printTableStats(const char *name, Table *table)
+{
+    TableStats stats = tableStats(table);
+
+    printf("%s: %d keys in %d slots, %d holes, %d tombstones, probes avg %.2f max %d\n",
+           name, stats.count, stats.capacity, stats.holes, stats.tombstones,
+           stats.averageProbe, stats.maxProbe);
+}
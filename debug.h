@@ -3,6 +3,7 @@
 
 #include "chunk.h"
 #include "debug.h"
+#include "table.h"
 
 // go through a chunk
 void disassembleChunk(Chunk *chunk, const char *name);
@@ -13,4 +14,7 @@ int disassembleInstruction(Chunk *chunk, int offset);
 // print contents of stack
 void printStack(Value stack[], Value *stackTop);
 
+// print how full a table is and how long its probes run
+void printTableStats(const char *name, Table *table);
+
 #endif
\ No newline at end of file
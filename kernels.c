@@ -0,0 +1,315 @@
+#include <math.h>
+
+#include "kernels.h"
+
+// the widest double vectors the target has, every kernel is written
+// once against these and finishes the last few values one at a time
+#if defined(__AVX__)
+#include <immintrin.h>
+
+#define LANES 4
+typedef __m256d Lanes;
+
+#define LOAD(pointer) _mm256_loadu_pd(pointer)
+#define STORE(pointer, lanes) _mm256_storeu_pd(pointer, lanes)
+#define SPLAT(value) _mm256_set1_pd(value)
+#define ADD(a, b) _mm256_add_pd(a, b)
+#define SUB(a, b) _mm256_sub_pd(a, b)
+#define MUL(a, b) _mm256_mul_pd(a, b)
+#define DIV(a, b) _mm256_div_pd(a, b)
+#define MIN(a, b) _mm256_min_pd(a, b)
+#define MAX(a, b) _mm256_max_pd(a, b)
+#define UNORDERED(a) _mm256_cmp_pd(a, a, _CMP_UNORD_Q)
+#define OR(a, b) _mm256_or_pd(a, b)
+#define ANY(lanes) _mm256_movemask_pd(lanes)
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define LANES 2
+typedef __m128d Lanes;
+
+#define LOAD(pointer) _mm_loadu_pd(pointer)
+#define STORE(pointer, lanes) _mm_storeu_pd(pointer, lanes)
+#define SPLAT(value) _mm_set1_pd(value)
+#define ADD(a, b) _mm_add_pd(a, b)
+#define SUB(a, b) _mm_sub_pd(a, b)
+#define MUL(a, b) _mm_mul_pd(a, b)
+#define DIV(a, b) _mm_div_pd(a, b)
+#define MIN(a, b) _mm_min_pd(a, b)
+#define MAX(a, b) _mm_max_pd(a, b)
+#define UNORDERED(a) _mm_cmpunord_pd(a, a)
+#define OR(a, b) _mm_or_pd(a, b)
+#define ANY(lanes) _mm_movemask_pd(lanes)
+#endif
+
+// sse2 is all the prefix sum needs, it scans two values at a time
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef LANES
+// spill the lanes and add them up
+static inline double sumLanes(Lanes lanes)
+{
+    double spilled[LANES];
+    STORE(spilled, lanes);
+
+    double sum = 0;
+    for (int i = 0; i < LANES; i++)
+        sum += spilled[i];
+
+    return sum;
+}
+#endif
+
+double sumDoubles(const double *values, int count)
+{
+    double sum = 0;
+    int i = 0;
+
+#ifdef LANES
+    // two accumulators so consecutive adds don't wait on each other
+    Lanes first = SPLAT(0), second = SPLAT(0);
+    for (; i + 2 * LANES <= count; i += 2 * LANES)
+    {
+        first = ADD(first, LOAD(values + i));
+        second = ADD(second, LOAD(values + i + LANES));
+    }
+
+    sum = sumLanes(ADD(first, second));
+#endif
+
+    for (; i < count; i++)
+        sum += values[i];
+
+    return sum;
+}
+
+double minDoubles(const double *values, int count)
+{
+    double min = values[0];
+    int i = 0;
+
+#ifdef LANES
+    if (count >= LANES)
+    {
+        // min_pd returns its second operand when either is nan, so
+        // whether a nan survived would depend on where it sat, keep
+        // them in a mask of their own instead
+        Lanes lanes = LOAD(values);
+        Lanes nans = UNORDERED(lanes);
+        for (i = LANES; i + LANES <= count; i += LANES)
+        {
+            Lanes next = LOAD(values + i);
+            nans = OR(nans, UNORDERED(next));
+            lanes = MIN(lanes, next);
+        }
+
+        if (ANY(nans))
+            return NAN;
+
+        double spilled[LANES];
+        STORE(spilled, lanes);
+        for (int lane = 0; lane < LANES; lane++)
+        {
+            if (spilled[lane] < min)
+                min = spilled[lane];
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        if (isnan(values[i]))
+            return NAN;
+
+        if (values[i] < min)
+            min = values[i];
+    }
+
+    return min;
+}
+
+double maxDoubles(const double *values, int count)
+{
+    double max = values[0];
+    int i = 0;
+
+#ifdef LANES
+    if (count >= LANES)
+    {
+        // max_pd returns its second operand when either is nan, so
+        // whether a nan survived would depend on where it sat, keep
+        // them in a mask of their own instead
+        Lanes lanes = LOAD(values);
+        Lanes nans = UNORDERED(lanes);
+        for (i = LANES; i + LANES <= count; i += LANES)
+        {
+            Lanes next = LOAD(values + i);
+            nans = OR(nans, UNORDERED(next));
+            lanes = MAX(lanes, next);
+        }
+
+        if (ANY(nans))
+            return NAN;
+
+        double spilled[LANES];
+        STORE(spilled, lanes);
+        for (int lane = 0; lane < LANES; lane++)
+        {
+            if (spilled[lane] > max)
+                max = spilled[lane];
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        if (isnan(values[i]))
+            return NAN;
+
+        if (values[i] > max)
+            max = values[i];
+    }
+
+    return max;
+}
+
+double dotDoubles(const double *a, const double *b, int count)
+{
+    double sum = 0;
+    int i = 0;
+
+#ifdef LANES
+    Lanes first = SPLAT(0), second = SPLAT(0);
+    for (; i + 2 * LANES <= count; i += 2 * LANES)
+    {
+        first = ADD(first, MUL(LOAD(a + i), LOAD(b + i)));
+        second = ADD(second, MUL(LOAD(a + i + LANES), LOAD(b + i + LANES)));
+    }
+
+    sum = sumLanes(ADD(first, second));
+#endif
+
+    for (; i < count; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+void scaleDoubles(double *values, int count, double factor)
+{
+    int i = 0;
+
+#ifdef LANES
+    Lanes lanes = SPLAT(factor);
+    for (; i + LANES <= count; i += LANES)
+        STORE(values + i, MUL(LOAD(values + i), lanes));
+#endif
+
+    for (; i < count; i++)
+        values[i] *= factor;
+}
+
+void prefixSumDoubles(double *values, int count)
+{
+    double running = 0;
+    int i = 0;
+
+#ifdef __SSE2__
+    // [a, b] plus [0, a] is [a, a + b], then the total so far is added
+    // to both and the new total is the upper lane
+    __m128d carry = _mm_setzero_pd();
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d pair = _mm_loadu_pd(values + i);
+        pair = _mm_add_pd(pair, _mm_unpacklo_pd(_mm_setzero_pd(), pair));
+        pair = _mm_add_pd(pair, carry);
+        _mm_storeu_pd(values + i, pair);
+        carry = _mm_unpackhi_pd(pair, pair);
+    }
+
+    running = _mm_cvtsd_f64(carry);
+#endif
+
+    for (; i < count; i++)
+    {
+        running += values[i];
+        values[i] = running;
+    }
+}
+
+// lane loops for an element-wise kernel, one per operand shape so the
+// loop bodies don't branch; a single value is splatted once up front
+#ifdef LANES
+#define ELEMENTWISE_LANES(laneOp)                                       \
+    if (aStep != 0 && bStep != 0)                                       \
+    {                                                                   \
+        for (; i + LANES <= count; i += LANES)                          \
+            STORE(dest + i, laneOp(LOAD(a + i), LOAD(b + i)));          \
+    }                                                                   \
+    else if (aStep != 0)                                                \
+    {                                                                   \
+        Lanes right = SPLAT(b[0]);                                      \
+        for (; i + LANES <= count; i += LANES)                          \
+            STORE(dest + i, laneOp(LOAD(a + i), right));                \
+    }                                                                   \
+    else                                                                \
+    {                                                                   \
+        Lanes left = SPLAT(a[0]);                                       \
+        for (; i + LANES <= count; i += LANES)                          \
+            STORE(dest + i, laneOp(left, LOAD(b + i)));                 \
+    }
+#else
+#define ELEMENTWISE_LANES(laneOp)
+#endif
+
+#define ELEMENTWISE_KERNEL(name, laneOp, op)                                 \
+    static void name(double *dest, const double *a, int aStep,               \
+                     const double *b, int bStep, int count)                  \
+    {                                                                        \
+        int i = 0;                                                           \
+        ELEMENTWISE_LANES(laneOp)                                            \
+        for (; i < count; i++)                                               \
+            dest[i] = a[i * aStep] op b[i * bStep];                          \
+    }
+
+ELEMENTWISE_KERNEL(addKernel, ADD, +)
+ELEMENTWISE_KERNEL(subtractKernel, SUB, -)
+ELEMENTWISE_KERNEL(multiplyKernel, MUL, *)
+ELEMENTWISE_KERNEL(divideKernel, DIV, /)
+
+// no vector pow, the libm call dominates anyway
+static void powerKernel(double *dest, const double *a, int aStep,
+                        const double *b, int bStep, int count)
+{
+    for (int i = 0; i < count; i++)
+        dest[i] = pow(a[i * aStep], b[i * bStep]);
+}
+
+void elementwiseDoubles(KernelOp op, double *dest, const double *a, int aStep,
+                        const double *b, int bStep, int count)
+{
+    if (count == 0)
+        return;
+
+    switch (op)
+    {
+    case KERNEL_ADD:
+        addKernel(dest, a, aStep, b, bStep, count);
+        break;
+    case KERNEL_SUBTRACT:
+        subtractKernel(dest, a, aStep, b, bStep, count);
+        break;
+    case KERNEL_MULTIPLY:
+        multiplyKernel(dest, a, aStep, b, bStep, count);
+        break;
+    case KERNEL_DIVIDE:
+        divideKernel(dest, a, aStep, b, bStep, count);
+        break;
+    case KERNEL_POWER:
+        powerKernel(dest, a, aStep, b, bStep, count);
+        break;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef blue_kernels_h
+#define blue_kernels_h
+
+#include "common.h"
+
+// loops over packed doubles, vectorized with avx or sse2 when the
+// compiler targets them and plain c otherwise
+
+// sum of count values, 0 when there are none
+double sumDoubles(const double *values, int count);
+
+// smallest and largest of count values, count must be above 0, nan
+// if any value is nan
+double minDoubles(const double *values, int count);
+double maxDoubles(const double *values, int count);
+
+// sum of the products of a and b, pair by pair
+double dotDoubles(const double *a, const double *b, int count);
+
+// multiply every value by factor, in place
+void scaleDoubles(double *values, int count, double factor);
+
+// replace every value with the sum of it and all before it, in place
+void prefixSumDoubles(double *values, int count);
+
+// element-wise operations behind blue's arithmetic operators
+typedef enum
+{
+    KERNEL_ADD,
+    KERNEL_SUBTRACT,
+    KERNEL_MULTIPLY,
+    KERNEL_DIVIDE,
+    KERNEL_POWER,
+} KernelOp;
+
+// dest[i] = a[i] op b[i], an operand with a step of 0 is a single value
+// used for every i; dest may be a or b
+void elementwiseDoubles(KernelOp op, double *dest, const double *a, int aStep,
+                        const double *b, int bStep, int count);
+
+#endif
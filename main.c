@@ -44,15 +44,9 @@ static char *readFile(const char *path)
     size_t fileSize = ftell(file);
     rewind(file);
 
-    // copy contents of file into heap, append EOF character
-    char *buffer = (char *)malloc(fileSize + 1);
-
-    // not enough memory to read file
-    if (buffer == NULL)
-    {
-        fprintf(stderr, "Not enough memory to read file: %s\nThis file is %lu bytes", path, fileSize + 1);
-        exit(74);
-    }
+    // read straight into a source buffer the vm keeps, string
+    // literals point into it instead of being copied out
+    char *buffer = newSource(fileSize);
 
     // write file to buffer
     size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
@@ -74,14 +68,11 @@ static char *readFile(const char *path)
 
 static void runFile(const char *path)
 {
-    // dynamically allocates and passes ownership
+    // the vm owns the file's contents and frees them with itself
     char *file = readFile(path);
 
     // convert to byte code
-    InterpretResult result = interpret(file);
-
-    // clear file since we have our program
-    free(file);
+    InterpretResult result = interpretSource(file);
 
     // exit if errors
     if (result == INTERPRET_COMPILE_ERROR)
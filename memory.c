@@ -1,10 +1,11 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "memory.h"
 #include "vm.h"
 
-// return reallocated heap space
-void *reallocate(void *pointer, size_t oldSize, size_t newSize)
+// the stock allocator, plain realloc and free
+void *defaultReallocate(void *userData, void *pointer, size_t oldSize, size_t newSize)
 {
     // delete item, return null, end of program
     if (newSize == 0)
@@ -14,16 +15,428 @@ void *reallocate(void *pointer, size_t oldSize, size_t newSize)
     }
 
     // make heap space
-    void *result = realloc(pointer, newSize);
+    return realloc(pointer, newSize);
+}
+
+// return reallocated heap space from the vm's allocator
+void *reallocate(void *pointer, size_t oldSize, size_t newSize)
+{
+    // stay under the vm's memory limit
+    if (newSize > oldSize && vm.memoryLimit != 0 &&
+        vm.bytesAllocated + (newSize - oldSize) > vm.memoryLimit)
+        outOfMemory(newSize);
+
+    void *result = vm.allocator.reallocate(vm.allocator.userData, pointer, oldSize, newSize);
+
+    // not enough memory, the old block is still valid
+    if (result == NULL && newSize != 0)
+        outOfMemory(newSize);
+
+    vm.bytesAllocated = vm.bytesAllocated - oldSize + newSize;
+    return result;
+}
+
+// slot sizes, steps of 16 up to 256 then roughly 1.5x
+static const uint16_t sizeClasses[HEAP_SIZE_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    144, 160, 176, 192, 208, 224, 240, 256,
+    384, 512, 768, 1024, 1536, 2048, 3072, 4096};
+
+// slots start after the page header, rounded up to 16 bytes
+#define PAGE_HEADER_SIZE ((sizeof(Page) + 15) & ~(size_t)15)
+
+// page holding a small object
+#define PAGE_OF(object) \
+    ((Page *)((uintptr_t)(object) & ~(uintptr_t)(HEAP_PAGE_SIZE - 1)))
+
+// address of a slot in a page
+#define PAGE_SLOT(page, index) \
+    ((Obj *)((char *)(page) + PAGE_HEADER_SIZE + (size_t)(index) * (page)->slotSize))
+
+// index of an object in its page
+#define SLOT_INDEX(page, object) \
+    ((int)(((char *)(object) - (char *)(page) - PAGE_HEADER_SIZE) / (page)->slotSize))
+
+// pages, alignment slack, and the arena header
+#define ARENA_BLOCK_SIZE ((HEAP_ARENA_PAGES + 1) * HEAP_PAGE_SIZE + sizeof(Arena))
+
+// large objects keep their header right in front of them
+#define LARGE_HEADER(object) ((LargeObject *)(object) - 1)
+
+// smallest slot that fits size bytes
+static int sizeClassOf(size_t size)
+{
+    if (size <= 256)
+        return size == 0 ? 0 : (int)((size + 15) / 16) - 1;
+
+    int sizeClass = 16;
+    while (sizeClasses[sizeClass] < size)
+        sizeClass++;
+
+    return sizeClass;
+}
+
+// bytes an object was allocated with, must match the
+// size passed to allocateObject
+static size_t objectSize(Obj *object)
+{
+    switch (object->type)
+    {
+    case OBJ_FUNCTION:
+        return sizeof(ObjFunction);
+    case OBJ_NATIVE:
+        return sizeof(ObjNative);
+    case OBJ_STRING:
+        return STRING_SIZE(((ObjString *)object)->length);
+    case OBJ_ROPE:
+        return sizeof(ObjRope);
+    case OBJ_SLICE:
+        return sizeof(ObjSlice);
+    case OBJ_STRING_BUILDER:
+        return sizeof(ObjStringBuilder);
+    case OBJ_MAP:
+        return sizeof(ObjMap);
+    case OBJ_LIST:
+        return sizeof(ObjList);
+    case OBJ_FLOAT64_ARRAY:
+        return sizeof(ObjFloat64Array);
+    case OBJ_PERSISTENT_MAP:
+        return sizeof(ObjPersistentMap);
+    case OBJ_PERSISTENT_VECTOR:
+        return sizeof(ObjPersistentVector);
+    case OBJ_TRIE_NODE:
+        return TRIE_NODE_SIZE(((ObjTrieNode *)object)->capacity);
+    }
+
+    // unreachable
+    return 0;
+}
+
+// empty heap
+void initHeap(Heap *heap)
+{
+    for (int type = 0; type < OBJ_TYPE_COUNT; type++)
+    {
+        for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; sizeClass++)
+        {
+            heap->pages[type][sizeClass] = NULL;
+            heap->freeSlots[type][sizeClass] = NULL;
+        }
+    }
+
+    heap->large = NULL;
+    heap->arenas = NULL;
+}
+
+// hand out the next page, making an arena when the current one is used up
+static Page *newPage(ObjType type, int sizeClass)
+{
+    Arena *arena = vm.heap.arenas;
+
+    if (arena == NULL || arena->usedPages == HEAP_ARENA_PAGES)
+    {
+        // over allocate by a page so the pages can be aligned, the
+        // arena's own header goes after them in the same block
+        void *block = reallocate(NULL, 0, ARENA_BLOCK_SIZE);
+        uintptr_t aligned = ((uintptr_t)block + HEAP_PAGE_SIZE - 1) & ~(uintptr_t)(HEAP_PAGE_SIZE - 1);
+
+        arena = (Arena *)(aligned + (size_t)HEAP_ARENA_PAGES * HEAP_PAGE_SIZE);
+        arena->block = block;
+        arena->pages = (char *)aligned;
+        arena->usedPages = 0;
+
+        arena->next = vm.heap.arenas;
+        vm.heap.arenas = arena;
+    }
+
+    Page *page = (Page *)(arena->pages + (size_t)arena->usedPages++ * HEAP_PAGE_SIZE);
+    page->type = type;
+    page->slotSize = sizeClasses[sizeClass];
+    page->slotCount = (uint16_t)((HEAP_PAGE_SIZE - PAGE_HEADER_SIZE) / page->slotSize);
+    page->used = 0;
+    memset(page->live, 0, sizeof(page->live));
+    memset(page->marks, 0, sizeof(page->marks));
+
+    // newest page first, it's the one being filled
+    page->next = vm.heap.pages[type][sizeClass];
+    vm.heap.pages[type][sizeClass] = page;
+
+    return page;
+}
+
+// objects too big for a page get their own block
+static Obj *allocateLarge(size_t size)
+{
+    LargeObject *header = (LargeObject *)reallocate(NULL, 0, sizeof(LargeObject) + size);
+    header->size = size;
+    header->isMarked = false;
+
+    header->prev = NULL;
+    header->next = vm.heap.large;
+    if (vm.heap.large != NULL)
+        vm.heap.large->prev = header;
+    vm.heap.large = header;
+
+    return (Obj *)(header + 1);
+}
+
+// make space for any object type
+Obj *allocateObject(size_t size, ObjType type)
+{
+    Obj *object;
+
+    if (size > HEAP_LARGE_SIZE)
+    {
+        object = allocateLarge(size);
+    }
+    else
+    {
+        int sizeClass = sizeClassOf(size);
+        void **freeSlots = &vm.heap.freeSlots[type][sizeClass];
+
+        if (*freeSlots != NULL)
+        {
+            // reuse a freed slot
+            object = (Obj *)*freeSlots;
+            *freeSlots = *(void **)object;
+        }
+        else
+        {
+            // bump into the newest page
+            Page *page = vm.heap.pages[type][sizeClass];
+            if (page == NULL || page->used == page->slotCount)
+                page = newPage(type, sizeClass);
+
+            object = PAGE_SLOT(page, page->used++);
+        }
+
+        Page *page = PAGE_OF(object);
+        int index = SLOT_INDEX(page, object);
+        page->live[index / 64] |= (uint64_t)1 << (index % 64);
+        page->marks[index / 64] &= ~((uint64_t)1 << (index % 64));
+    }
+
+    object->type = type;
+    return object;
+}
+
+// unlink a large object from the heap's list
+static void unlinkLarge(LargeObject *header)
+{
+    if (header->prev != NULL)
+        header->prev->next = header->next;
+    else
+        vm.heap.large = header->next;
+
+    if (header->next != NULL)
+        header->next->prev = header->prev;
+}
+
+// give a slot of size bytes back to the heap
+static void releaseSlot(Obj *object, size_t size)
+{
+    if (size > HEAP_LARGE_SIZE)
+    {
+        LargeObject *header = LARGE_HEADER(object);
+        unlinkLarge(header);
+        reallocate(header, sizeof(LargeObject) + size, 0);
+        return;
+    }
+
+    Page *page = PAGE_OF(object);
+    int index = SLOT_INDEX(page, object);
+    page->live[index / 64] &= ~((uint64_t)1 << (index % 64));
 
-    // exit program if there's not enough memory
-    if (result == NULL)
-        exit(1);
+    // thread the slot onto the free list for its type and size
+    void **freeSlots = &vm.heap.freeSlots[object->type][sizeClassOf(size)];
+    *(void **)object = *freeSlots;
+    *freeSlots = object;
+}
+
+// give an object's slot back to the heap
+void freeSlot(Obj *object)
+{
+    releaseSlot(object, objectSize(object));
+}
+
+// move an object into a slot of a different size, keeping its first bytes;
+// large objects are resized where they are when the allocator allows it
+Obj *resizeObject(Obj *object, size_t oldSize, size_t newSize)
+{
+    if (oldSize > HEAP_LARGE_SIZE && newSize > HEAP_LARGE_SIZE)
+    {
+        LargeObject *header = (LargeObject *)reallocate(LARGE_HEADER(object),
+                                                        sizeof(LargeObject) + oldSize, sizeof(LargeObject) + newSize);
+        header->size = newSize;
+
+        // the block may have moved, point its neighbors at it
+        if (header->prev != NULL)
+            header->prev->next = header;
+        else
+            vm.heap.large = header;
+
+        if (header->next != NULL)
+            header->next->prev = header;
+
+        return (Obj *)(header + 1);
+    }
+
+    // same slot size, nothing to move
+    if (oldSize <= HEAP_LARGE_SIZE && newSize <= HEAP_LARGE_SIZE &&
+        sizeClassOf(oldSize) == sizeClassOf(newSize))
+    {
+        return object;
+    }
+
+    Obj *resized = allocateObject(newSize, object->type);
+    memcpy(resized, object, oldSize < newSize ? oldSize : newSize);
+    releaseSlot(object, oldSize);
+    return resized;
+}
+
+// visit every live object, page by page
+void eachObject(HeapVisitor visitor)
+{
+    for (int type = 0; type < OBJ_TYPE_COUNT; type++)
+    {
+        for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; sizeClass++)
+        {
+            for (Page *page = vm.heap.pages[type][sizeClass]; page != NULL; page = page->next)
+            {
+                // skip empty words of the live bitmap
+                for (int word = 0; word * 64 < page->used; word++)
+                {
+                    uint64_t bits = page->live[word];
+
+                    while (bits != 0)
+                    {
+                        int bit = __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        visitor(PAGE_SLOT(page, word * 64 + bit));
+                    }
+                }
+            }
+        }
+    }
+
+    // large objects have no pages
+    LargeObject *header = vm.heap.large;
+    while (header != NULL)
+    {
+        LargeObject *next = header->next;
+        visitor((Obj *)(header + 1));
+        header = next;
+    }
+}
+
+// check the side table for a mark
+bool isMarked(Obj *object)
+{
+    if (objectSize(object) > HEAP_LARGE_SIZE)
+        return LARGE_HEADER(object)->isMarked;
+
+    Page *page = PAGE_OF(object);
+    int index = SLOT_INDEX(page, object);
+    return (page->marks[index / 64] >> (index % 64)) & 1;
+}
+
+// set an object's mark bit
+void markObject(Obj *object)
+{
+    if (objectSize(object) > HEAP_LARGE_SIZE)
+    {
+        LARGE_HEADER(object)->isMarked = true;
+        return;
+    }
+
+    Page *page = PAGE_OF(object);
+    int index = SLOT_INDEX(page, object);
+    page->marks[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+// unmark everything, whole bitmaps at a time
+void clearMarks()
+{
+    for (int type = 0; type < OBJ_TYPE_COUNT; type++)
+    {
+        for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; sizeClass++)
+        {
+            for (Page *page = vm.heap.pages[type][sizeClass]; page != NULL; page = page->next)
+                memset(page->marks, 0, sizeof(page->marks));
+        }
+    }
+
+    for (LargeObject *header = vm.heap.large; header != NULL; header = header->next)
+        header->isMarked = false;
+}
+
+// smallest block a scratch arena asks for
+#define SCRATCH_BLOCK_SIZE (16 * 1024)
+
+// scratch allocations stay 8 byte aligned
+#define SCRATCH_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+// empty scratch arena
+void initScratchArena(ScratchArena *arena)
+{
+    arena->blocks = NULL;
+}
+
+// bump allocate, growing the last allocation in place when it fits
+void *scratchReallocate(ScratchArena *arena, void *pointer, size_t oldSize, size_t newSize)
+{
+    // memory is only given back when the arena is freed
+    if (newSize == 0)
+        return NULL;
+
+    ScratchBlock *block = arena->blocks;
+    size_t oldAligned = SCRATCH_ALIGN(oldSize);
+    size_t newAligned = SCRATCH_ALIGN(newSize);
+
+    // newest allocation in the block, just move the end
+    if (pointer != NULL && block != NULL &&
+        (char *)pointer + oldAligned == block->data + block->used &&
+        block->used - oldAligned + newAligned <= block->size)
+    {
+        block->used = block->used - oldAligned + newAligned;
+        return pointer;
+    }
+
+    if (block == NULL || block->size - block->used < newAligned)
+    {
+        size_t size = newAligned > SCRATCH_BLOCK_SIZE ? newAligned : SCRATCH_BLOCK_SIZE;
+        block = (ScratchBlock *)reallocate(NULL, 0, sizeof(ScratchBlock) + size);
+        block->size = size;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void *result = block->data + block->used;
+    block->used += newAligned;
+
+    if (pointer != NULL)
+        memcpy(result, pointer, oldSize < newSize ? oldSize : newSize);
 
     return result;
 }
 
-//
+// free every block of an arena
+void freeScratchArena(ScratchArena *arena)
+{
+    ScratchBlock *block = arena->blocks;
+
+    while (block != NULL)
+    {
+        ScratchBlock *next = block->next;
+        reallocate(block, sizeof(ScratchBlock) + block->size, 0);
+        block = next;
+    }
+
+    initScratchArena(arena);
+}
+
+// release memory an object owns outside of its slot
 static void freeObject(Obj *object)
 {
     switch (object->type)
@@ -32,17 +445,28 @@ static void freeObject(Obj *object)
     {
         ObjFunction *function = (ObjFunction *)object;
         freeChunk(&function->chunk);
-        FREE(ObjFunction, object);
         break;
     }
     case OBJ_NATIVE:
-        FREE(ObjNative, object);
-        break;
     case OBJ_STRING:
+    case OBJ_ROPE:
+    case OBJ_SLICE:
+    case OBJ_STRING_BUILDER:
+    case OBJ_PERSISTENT_MAP:
+    case OBJ_PERSISTENT_VECTOR:
+    case OBJ_TRIE_NODE:
+        // chars are inline, the others only point at other objects or the source
+        break;
+    case OBJ_MAP:
+        freeTable(&((ObjMap *)object)->table);
+        break;
+    case OBJ_LIST:
+        freeValueArray(&((ObjList *)object)->items);
+        break;
+    case OBJ_FLOAT64_ARRAY:
     {
-        ObjString *string = (ObjString *)object;
-        FREE_ARRAY(char, string->chars, string->length + 1);
-        FREE(ObjString, object);
+        ObjFloat64Array *array = (ObjFloat64Array *)object;
+        FREE_ARRAY(double, array->values, array->count);
         break;
     }
     }
@@ -51,12 +475,24 @@ static void freeObject(Obj *object)
 // frees all objects in the vm
 void freeObjects()
 {
-    Obj *curr = vm.objects;
+    eachObject(freeObject);
 
-    while (curr != NULL)
+    // large objects and whole arenas go at once
+    LargeObject *header = vm.heap.large;
+    while (header != NULL)
     {
-        Obj *next = curr->next;
-        freeObject(curr);
-        curr = next;
+        LargeObject *next = header->next;
+        reallocate(header, sizeof(LargeObject) + header->size, 0);
+        header = next;
     }
-}
\ No newline at end of file
+
+    Arena *arena = vm.heap.arenas;
+    while (arena != NULL)
+    {
+        Arena *next = arena->next;
+        reallocate(arena->block, ARENA_BLOCK_SIZE, 0);
+        arena = next;
+    }
+
+    initHeap(&vm.heap);
+}
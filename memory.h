@@ -23,9 +23,153 @@
 #define FREE_ARRAY(type, pointer, oldCount) \
     reallocate(pointer, sizeof(type) * (oldCount), 0)
 
+// grow an array inside a scratch arena
+#define GROW_SCRATCH(arena, type, pointer, oldCount, newCount) \
+    (type *)scratchReallocate(arena, pointer, sizeof(type) * (oldCount), sizeof(type) * (newCount))
+
+// objects live in fixed size pages, every page holds a single
+// object type and slot size so walking the heap is a linear scan
+#define HEAP_PAGE_SIZE (16 * 1024)
+
+// pages are carved out of arenas aligned to the page size,
+// which lets an object find its page by masking its address
+#define HEAP_ARENA_PAGES 16
+
+// objects bigger than this get a dedicated allocation
+#define HEAP_LARGE_SIZE 4096
+
+// smallest slot is 16 bytes, bounds the page bitmaps
+#define HEAP_MAX_SLOTS (HEAP_PAGE_SIZE / 16)
+
+// number of slot sizes between 16 bytes and HEAP_LARGE_SIZE
+#define HEAP_SIZE_CLASSES 24
+
+// page of same typed, same sized object slots
+typedef struct Page
+{
+    struct Page *next;
+
+    // ObjType of every slot
+    uint8_t type;
+
+    // bytes per slot and how many fit in the page
+    uint16_t slotSize;
+    uint16_t slotCount;
+
+    // slots handed out so far, the rest are untouched
+    uint16_t used;
+
+    // side tables: which slots hold objects and which are marked
+    uint64_t live[HEAP_MAX_SLOTS / 64];
+    uint64_t marks[HEAP_MAX_SLOTS / 64];
+} Page;
+
+// header placed in front of an object too big for a page
+typedef struct LargeObject
+{
+    struct LargeObject *next;
+    struct LargeObject *prev;
+    size_t size;
+    bool isMarked;
+} LargeObject;
+
+// aligned block of pages
+typedef struct Arena
+{
+    struct Arena *next;
+
+    // raw allocation and the first aligned page inside it
+    void *block;
+    char *pages;
+    int usedPages;
+} Arena;
+
+// block of scratch memory, handed out front to back
+typedef struct ScratchBlock
+{
+    struct ScratchBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ScratchBlock;
+
+// bump allocator for short lived data like the compiler's
+// growing chunks, all of it is freed at once
+struct ScratchArena
+{
+    ScratchBlock *blocks;
+};
+
+// every object in the vm
+typedef struct
+{
+    // pages for each object type and size class
+    Page *pages[OBJ_TYPE_COUNT][HEAP_SIZE_CLASSES];
+
+    // freed slots, threaded through the slots themselves
+    void *freeSlots[OBJ_TYPE_COUNT][HEAP_SIZE_CLASSES];
+
+    // objects too big for pages
+    LargeObject *large;
+
+    // page storage
+    Arena *arenas;
+} Heap;
+
+// embedder supplied allocation, same contract as reallocate:
+// a NULL pointer allocates, newSize 0 frees, NULL result means out of memory
+typedef void *(*ReallocateFn)(void *userData, void *pointer, size_t oldSize, size_t newSize);
+
+// optional, release everything the allocator handed out in one go
+typedef void (*FreeAllFn)(void *userData);
+
+// allocation callbacks for a vm and the context passed to them
+typedef struct
+{
+    ReallocateFn reallocate;
+    FreeAllFn freeAll;
+    void *userData;
+} Allocator;
+
+// called for every object when walking the heap
+typedef void (*HeapVisitor)(Obj *object);
+
 // free, exit, or make space
 void *reallocate(void *pointer, size_t oldSize, size_t newSize);
 
+// realloc and free, what a vm uses unless given an allocator
+void *defaultReallocate(void *userData, void *pointer, size_t oldSize, size_t newSize);
+
+// empty heap
+void initHeap(Heap *heap);
+
+// place a new object of size bytes in a page for its type
+Obj *allocateObject(size_t size, ObjType type);
+
+// give an object's slot back to the heap
+void freeSlot(Obj *object);
+
+// grow or shrink an object, fields that decide its size
+// must be updated to match newSize after the call
+Obj *resizeObject(Obj *object, size_t oldSize, size_t newSize);
+
+// visit every live object, page by page
+void eachObject(HeapVisitor visitor);
+
+// empty scratch arena
+void initScratchArena(ScratchArena *arena);
+
+// allocate or grow inside an arena, the newest allocation grows in place
+void *scratchReallocate(ScratchArena *arena, void *pointer, size_t oldSize, size_t newSize);
+
+// free every block of an arena
+void freeScratchArena(ScratchArena *arena);
+
+// mark bits, kept in the page side tables
+bool isMarked(Obj *object);
+void markObject(Obj *object);
+void clearMarks();
+
 // frees all objects
 void freeObjects();
 
@@ -0,0 +1,605 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "number.h"
+
+// grisu2 (loitsch, "printing floating-point numbers quickly and accurately
+// with integers"), digits come out of 64 bit integer math instead of printf
+
+// double as f * 2^e with a 64 bit significand
+typedef struct
+{
+    uint64_t f;
+    int e;
+} DiyFp;
+
+#define DOUBLE_SIGNIFICAND_SIZE 52
+#define DOUBLE_EXPONENT_BIAS (0x3FF + DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_HIDDEN_BIT ((uint64_t)1 << DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_SIGNIFICAND_MASK (DOUBLE_HIDDEN_BIT - 1)
+#define DOUBLE_EXPONENT_MASK 0x7FF0000000000000ull
+
+// normalized 10^k for k = -348, -340, ..., 340
+static const uint64_t cachedPowersF[] = {
+    0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+    0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+    0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+    0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+    0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+    0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+    0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+    0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+    0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+    0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+    0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+    0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+    0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+    0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+    0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+    0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+    0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+    0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+    0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+    0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+    0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+    0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+    0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+    0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+    0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+    0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+    0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+    0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+    0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+};
+
+static const int16_t cachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint64_t powersOf10[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+static uint64_t doubleBits(double number)
+{
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return bits;
+}
+
+static DiyFp diyFpOf(double number)
+{
+    uint64_t bits = doubleBits(number);
+    int biasedExponent = (int)((bits & DOUBLE_EXPONENT_MASK) >> DOUBLE_SIGNIFICAND_SIZE);
+    uint64_t significand = bits & DOUBLE_SIGNIFICAND_MASK;
+
+    DiyFp fp;
+    if (biasedExponent != 0)
+    {
+        fp.f = significand + DOUBLE_HIDDEN_BIT;
+        fp.e = biasedExponent - DOUBLE_EXPONENT_BIAS;
+    }
+    else
+    {
+        // subnormal
+        fp.f = significand;
+        fp.e = 1 - DOUBLE_EXPONENT_BIAS;
+    }
+    return fp;
+}
+
+static DiyFp diyFpSubtract(DiyFp a, DiyFp b)
+{
+    DiyFp fp = {a.f - b.f, a.e};
+    return fp;
+}
+
+// product rounded to the upper 64 bits
+static DiyFp diyFpMultiply(DiyFp a, DiyFp b)
+{
+    uint64_t m32 = 0xFFFFFFFFu;
+    uint64_t ah = a.f >> 32, al = a.f & m32;
+    uint64_t bh = b.f >> 32, bl = b.f & m32;
+
+    uint64_t hh = ah * bh;
+    uint64_t lh = al * bh;
+    uint64_t hl = ah * bl;
+    uint64_t ll = al * bl;
+
+    uint64_t middle = (ll >> 32) + (hl & m32) + (lh & m32) + (1u << 31);
+
+    DiyFp fp = {hh + (hl >> 32) + (lh >> 32) + (middle >> 32), a.e + b.e + 64};
+    return fp;
+}
+
+static DiyFp diyFpNormalize(DiyFp fp)
+{
+    while (!(fp.f & ((uint64_t)1 << 63)))
+    {
+        fp.f <<= 1;
+        fp.e--;
+    }
+    return fp;
+}
+
+// neighbours halfway to the next doubles down and up, normalized
+// to the same exponent, anything between them reads back as number
+static void boundaries(double number, DiyFp *minus, DiyFp *plus)
+{
+    DiyFp v = diyFpOf(number);
+
+    DiyFp upper = {(v.f << 1) + 1, v.e - 1};
+    while (!(upper.f & (DOUBLE_HIDDEN_BIT << 1)))
+    {
+        upper.f <<= 1;
+        upper.e--;
+    }
+    upper.f <<= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
+    upper.e -= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
+
+    // the gap below a power of two is half the gap above it
+    DiyFp lower;
+    if (v.f == DOUBLE_HIDDEN_BIT)
+    {
+        lower.f = (v.f << 2) - 1;
+        lower.e = v.e - 2;
+    }
+    else
+    {
+        lower.f = (v.f << 1) - 1;
+        lower.e = v.e - 1;
+    }
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+
+    *minus = lower;
+    *plus = upper;
+}
+
+// cached power that brings exponent e into [-60, -32], sets k to its
+// negated decimal exponent
+static DiyFp cachedPower(int e, int *k)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int)dk;
+    if (dk - ik > 0.0)
+        ik++;
+
+    int index = (ik >> 3) + 1;
+    *k = -(-348 + index * 8);
+
+    DiyFp fp = {cachedPowersF[index], cachedPowersE[index]};
+    return fp;
+}
+
+static int countDigits(uint32_t n)
+{
+    int count = 1;
+    while (n >= 10)
+    {
+        n /= 10;
+        count++;
+    }
+    return count;
+}
+
+// nudge the last digit toward the exact value while it stays in range
+static void roundWeed(char *buffer, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance)
+{
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+    {
+        buffer[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+// shortest digits inside the scaled boundaries, stopping as soon as
+// the remainder fits within delta
+static int generateDigits(DiyFp w, DiyFp upper, uint64_t delta, char *buffer, int *k)
+{
+    DiyFp one = {(uint64_t)1 << -upper.e, upper.e};
+    DiyFp distance = diyFpSubtract(upper, w);
+
+    uint32_t integral = (uint32_t)(upper.f >> -one.e);
+    uint64_t fraction = upper.f & (one.f - 1);
+
+    int kappa = countDigits(integral);
+    int length = 0;
+
+    while (kappa > 0)
+    {
+        uint32_t divisor = (uint32_t)powersOf10[kappa - 1];
+        uint32_t digit = integral / divisor;
+        integral %= divisor;
+
+        if (digit != 0 || length != 0)
+            buffer[length++] = (char)('0' + digit);
+        kappa--;
+
+        uint64_t rest = ((uint64_t)integral << -one.e) + fraction;
+        if (rest <= delta)
+        {
+            *k += kappa;
+            roundWeed(buffer, length, delta, rest, powersOf10[kappa] << -one.e, distance.f);
+            return length;
+        }
+    }
+
+    for (;;)
+    {
+        fraction *= 10;
+        delta *= 10;
+
+        char digit = (char)(fraction >> -one.e);
+        if (digit != 0 || length != 0)
+            buffer[length++] = (char)('0' + digit);
+
+        fraction &= one.f - 1;
+        kappa--;
+
+        if (fraction < delta)
+        {
+            *k += kappa;
+            int index = -kappa;
+            roundWeed(buffer, length, delta, fraction, one.f, index < 20 ? distance.f * powersOf10[index] : 0);
+            return length;
+        }
+    }
+}
+
+// digits of a positive finite number, value is digits * 10^k
+static int grisu2(double number, char *buffer, int *k)
+{
+    DiyFp minus, plus;
+    boundaries(number, &minus, &plus);
+
+    DiyFp power = cachedPower(plus.e, k);
+    DiyFp w = diyFpMultiply(diyFpNormalize(diyFpOf(number)), power);
+    DiyFp upper = diyFpMultiply(plus, power);
+    DiyFp lower = diyFpMultiply(minus, power);
+
+    // stay strictly inside the boundaries
+    upper.f--;
+    lower.f++;
+
+    return generateDigits(w, upper, upper.f - lower.f, buffer, k);
+}
+
+static int writeExponent(int exponent, char *buffer)
+{
+    int length = 0;
+    buffer[length++] = 'e';
+    buffer[length++] = exponent < 0 ? '-' : '+';
+    if (exponent < 0)
+        exponent = -exponent;
+
+    if (exponent >= 100)
+    {
+        buffer[length++] = (char)('0' + exponent / 100);
+        exponent %= 100;
+        buffer[length++] = (char)('0' + exponent / 10);
+    }
+    else if (exponent >= 10)
+    {
+        buffer[length++] = (char)('0' + exponent / 10);
+    }
+    buffer[length++] = (char)('0' + exponent % 10);
+
+    return length;
+}
+
+// lay out digits * 10^k, plain decimals between 1e-7 and 1e21,
+// exponent form outside of that
+static int layoutDigits(char *buffer, int length, int k)
+{
+    // decimal point position, value is 0.digits * 10^point
+    int point = length + k;
+
+    if (k >= 0 && point <= 21)
+    {
+        // whole number, 1234e3 -> 1234000
+        memset(buffer + length, '0', k);
+        return point;
+    }
+
+    if (point > 0 && point <= 21)
+    {
+        // 1234e-2 -> 12.34
+        memmove(buffer + point + 1, buffer + point, length - point);
+        buffer[point] = '.';
+        return length + 1;
+    }
+
+    if (point > -6 && point <= 0)
+    {
+        // 1234e-6 -> 0.001234
+        int offset = 2 - point;
+        memmove(buffer + offset, buffer, length);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        memset(buffer + 2, '0', -point);
+        return length + offset;
+    }
+
+    if (length == 1)
+    {
+        // 1e30
+        return 1 + writeExponent(point - 1, buffer + 1);
+    }
+
+    // 1234e30 -> 1.234e+33
+    memmove(buffer + 2, buffer + 1, length - 1);
+    buffer[1] = '.';
+    return length + 1 + writeExponent(point - 1, buffer + length + 1);
+}
+
+// digits of an integer, written back to front
+static int formatInteger(uint64_t integer, char *buffer)
+{
+    char digits[20];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while (integer != 0);
+
+    for (int i = 0; i < count; i++)
+        buffer[i] = digits[count - 1 - i];
+
+    return count;
+}
+
+// shortest round trip text of number, integers skip the float path
+int formatNumber(double number, char *buffer)
+{
+    int length = 0;
+
+    if (isnan(number))
+    {
+        memcpy(buffer, "nan", 4);
+        return 3;
+    }
+
+    if (signbit(number))
+    {
+        buffer[length++] = '-';
+        number = -number;
+    }
+
+    if (isinf(number))
+    {
+        memcpy(buffer + length, "inf", 4);
+        return length + 3;
+    }
+
+    // exact integers, 2^53 and under
+    if (number <= 9007199254740992.0 && number == (double)(uint64_t)number)
+    {
+        length += formatInteger((uint64_t)number, buffer + length);
+        buffer[length] = '\0';
+        return length;
+    }
+
+    int k;
+    int digits = grisu2(number, buffer + length, &k);
+    length += layoutDigits(buffer + length, digits, k);
+    buffer[length] = '\0';
+    return length;
+}
+
+// most significant digits a uint64_t holds without overflowing
+#define MAX_MANTISSA_DIGITS 19
+
+// largest integer a double holds exactly
+#define MAX_EXACT_INTEGER 9007199254740992ull
+
+// powers of ten a double holds exactly
+static const double exactPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// clinger's fast path, an exact mantissa and power of ten give the
+// correctly rounded result in one multiply or divide
+static bool fastDecimal(uint64_t mantissa, int exponent, double *value)
+{
+    if (mantissa > MAX_EXACT_INTEGER)
+        return false;
+
+    if (exponent >= 0 && exponent <= 22)
+    {
+        *value = (double)mantissa * exactPowersOf10[exponent];
+        return true;
+    }
+
+    if (exponent < 0 && exponent >= -22)
+    {
+        *value = (double)mantissa / exactPowersOf10[-exponent];
+        return true;
+    }
+
+    // 12e30, move the extra zeros into the mantissa while it stays exact
+    if (exponent > 22 && exponent <= 22 + 15)
+    {
+        for (int i = 22; i < exponent; i++)
+        {
+            mantissa *= 10;
+            if (mantissa > MAX_EXACT_INTEGER)
+                return false;
+        }
+
+        *value = (double)mantissa * 1e22;
+        return true;
+    }
+
+    return false;
+}
+
+// significant digits strtod is given, enough to round any double: the
+// longest exact halfway point between two doubles has 767
+#define SLOW_DIGITS 800
+
+// hand the digits to strtod, for literals too long or too far out
+// of range to round exactly on the fast path. digits past SLOW_DIGITS
+// only matter if they aren't all zero, so they become one sticky digit
+static double slowDecimal(const char *chars, int length)
+{
+    char buffer[SLOW_DIGITS + 32];
+    int count = 0;
+    long exponent = 0;
+    bool isFraction = false;
+    bool sticky = false;
+
+    const char *c = chars;
+    const char *end = chars + length;
+    for (; c < end && *c != 'e' && *c != 'E'; c++)
+    {
+        if (*c == '_')
+            continue;
+
+        if (*c == '.')
+        {
+            isFraction = true;
+            continue;
+        }
+
+        // leading zeros only move the point
+        if (count == 0 && *c == '0')
+        {
+            exponent -= isFraction;
+            continue;
+        }
+
+        if (count < SLOW_DIGITS)
+        {
+            buffer[count++] = *c;
+            exponent -= isFraction;
+        }
+        else
+        {
+            sticky |= *c != '0';
+            exponent += !isFraction;
+        }
+    }
+
+    if (sticky)
+    {
+        buffer[count++] = '1';
+        exponent--;
+    }
+
+    if (c < end)
+    {
+        c++;
+        bool negative = c < end && *c == '-';
+        if (c < end && (*c == '-' || *c == '+'))
+            c++;
+
+        long power = 0;
+        for (; c < end; c++)
+        {
+            if (*c != '_' && power < 100000)
+                power = power * 10 + (*c - '0');
+        }
+
+        exponent += negative ? -power : power;
+    }
+
+    snprintf(buffer + count, sizeof(buffer) - count, "e%ld", exponent);
+    return strtod(buffer, NULL);
+}
+
+// parse digits, fraction and exponent in one pass, the scanner has
+// already checked that the literal is well formed
+double parseNumber(const char *chars, int length)
+{
+    const char *c = chars;
+    const char *end = chars + length;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+
+    for (; c < end && ((*c >= '0' && *c <= '9') || *c == '_'); c++)
+    {
+        if (*c == '_')
+            continue;
+
+        if (digits < MAX_MANTISSA_DIGITS)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+            if (mantissa != 0)
+                digits++;
+        }
+        else
+        {
+            truncated |= *c != '0';
+            exponent++;
+        }
+    }
+
+    if (c < end && *c == '.')
+    {
+        for (c++; c < end && ((*c >= '0' && *c <= '9') || *c == '_'); c++)
+        {
+            if (*c == '_')
+                continue;
+
+            if (digits < MAX_MANTISSA_DIGITS)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+                if (mantissa != 0)
+                    digits++;
+                exponent--;
+            }
+            else
+            {
+                truncated |= *c != '0';
+            }
+        }
+    }
+
+    if (c < end && (*c == 'e' || *c == 'E'))
+    {
+        c++;
+        bool negative = c < end && *c == '-';
+        if (c < end && (*c == '-' || *c == '+'))
+            c++;
+
+        int power = 0;
+        for (; c < end; c++)
+        {
+            // clamp, anything this far out is 0 or infinity anyway
+            if (*c != '_' && power < 100000)
+                power = power * 10 + (*c - '0');
+        }
+
+        exponent += negative ? -power : power;
+    }
+
+    if (mantissa == 0)
+        return 0.0;
+
+    double value;
+    if (!truncated && fastDecimal(mantissa, exponent, &value))
+        return value;
+
+    return slowDecimal(chars, length);
+}
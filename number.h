@@ -0,0 +1,16 @@
+#ifndef blue_number_h
+#define blue_number_h
+
+#include "common.h"
+
+// longest number formatNumber writes, with its null terminator
+#define NUMBER_BUFFER_SIZE 32
+
+// write the shortest text that reads back as the same number,
+// returns its length
+int formatNumber(double number, char *buffer);
+
+// value of a scanned number literal, _ separators are skipped
+double parseNumber(const char *chars, int length);
+
+#endif
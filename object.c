@@ -1,30 +1,20 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "memory.h"
 #include "object.h"
+#include "persistent.h"
 #include "table.h"
 #include "value.h"
 #include "vm.h"
 
-// init object macro
+// init object macro, objects are placed in the heap's typed pages
 #define ALLOCATE_OBJ(type, objectType) (type *)allocateObject(sizeof(type), objectType)
 
-// make space for any object type
-static Obj *allocateObject(size_t size, ObjType type)
-{
-    // allocate
-    Obj *object = (Obj *)reallocate(NULL, 0, size);
-    object->type = type;
-
-    // insert object at the head,
-    // the linked list is essentially in reverse
-    object->next = vm.objects;
-    vm.objects = object;
-
-    return object;
-}
-
 // request heap space for this function
 ObjFunction *newFunction()
 {
@@ -43,48 +33,232 @@ ObjNative *newNative(NativeFunc function)
     return native;
 }
 
-// uses FNV-1a hash function
-static uint32_t hashString(const char *key, int length)
+// wyhash style constants, odd with well spread bits
+#define HASH_SECRET0 0xa0761d6478bd642full
+#define HASH_SECRET1 0xe7037ed1a0b428dbull
+#define HASH_SECRET2 0x8ebc6af09c88c6e3ull
+#define HASH_SECRET3 0x589965cc75374cc3ull
+
+// multiply into 128 bits and fold the halves together
+static inline uint64_t hashMix(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    // portable 64x64 -> 128 multiply from 32 bit halves
+    uint64_t aLow = (uint32_t)a, aHigh = a >> 32;
+    uint64_t bLow = (uint32_t)b, bHigh = b >> 32;
+    uint64_t low = aLow * bLow, mid1 = aHigh * bLow, mid2 = aLow * bHigh, high = aHigh * bHigh;
+    uint64_t carry = ((low >> 32) + (uint32_t)mid1 + (uint32_t)mid2) >> 32;
+    uint64_t resultLow = low + (mid1 << 32) + (mid2 << 32);
+    uint64_t resultHigh = high + (mid1 >> 32) + (mid2 >> 32) + carry;
+    return resultLow ^ resultHigh;
+#endif
+}
+
+// unaligned loads, memcpy compiles down to a single mov
+static inline uint64_t read64(const char *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t read32(const char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// wyhash style hash, 16 to 48 bytes per step instead of FNV-1a's one
+uint32_t hashString(const char *key, int length)
 {
-    uint32_t hash = 2166136261u;
+    uint64_t seed = HASH_SECRET0;
+    uint64_t a, b;
+
+    if (length <= 16)
+    {
+        if (length >= 4)
+        {
+            // two overlapping pairs of 4 byte reads cover 4 to 16 bytes
+            int shift = (length >> 3) << 2;
+            a = (read32(key) << 32) | read32(key + shift);
+            b = (read32(key + length - 4) << 32) | read32(key + length - 4 - shift);
+        }
+        else if (length > 0)
+        {
+            a = ((uint64_t)(uint8_t)key[0] << 16) | ((uint64_t)(uint8_t)key[length >> 1] << 8) | (uint8_t)key[length - 1];
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        int remaining = length;
+        const char *p = key;
+
+        // three independent lanes keep the multiplier busy on long strings
+        if (remaining > 48)
+        {
+            uint64_t seed1 = seed, seed2 = seed;
+            do
+            {
+                seed = hashMix(read64(p) ^ HASH_SECRET1, read64(p + 8) ^ seed);
+                seed1 = hashMix(read64(p + 16) ^ HASH_SECRET2, read64(p + 24) ^ seed1);
+                seed2 = hashMix(read64(p + 32) ^ HASH_SECRET3, read64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (remaining > 16)
+        {
+            seed = hashMix(read64(p) ^ HASH_SECRET1, read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+
+        // last 16 bytes, overlapping what was already mixed
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+
+    uint64_t hash = hashMix(HASH_SECRET1 ^ (uint64_t)length, hashMix(a ^ HASH_SECRET1, b ^ seed));
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// compare chars with a few overlapping loads, keys are mostly short
+// and longer strings go to the library's wide compare
+bool charsEqual(const char *a, const char *b, int length)
+{
+    if (length > 32)
+        return memcmp(a, b, length) == 0;
+
+#ifdef __SSE2__
+    if (length >= 16)
+    {
+        // the first and last 16 bytes cover 16 to 32
+        __m128i head = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)a), _mm_loadu_si128((const __m128i *)b));
+        __m128i tail = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + length - 16)),
+                                      _mm_loadu_si128((const __m128i *)(b + length - 16)));
+        return _mm_movemask_epi8(_mm_and_si128(head, tail)) == 0xffff;
+    }
+#endif
+
+    if (length >= 8)
+    {
+        // whole words, then a last one overlapping the ones before it
+        for (int i = 0; i < length - 8; i += 8)
+        {
+            if (read64(a + i) != read64(b + i))
+                return false;
+        }
+
+        return read64(a + length - 8) == read64(b + length - 8);
+    }
+
+    if (length >= 4)
+        return read32(a) == read32(b) && read32(a + length - 4) == read32(b + length - 4);
 
     for (int i = 0; i < length; i++)
     {
-        hash ^= (uint8_t)key[i];
-        hash *= 16777619;
+        if (a[i] != b[i])
+            return false;
     }
 
-    return hash;
+    return true;
 }
 
-// creates new string on heap and initializes fields
-// todo: perform hashing here
-static ObjString *allocateString(char *chars, int length, uint32_t hash)
+// creates a string with inline space for its chars, the caller
+// fills in chars and hands it to takeString to be hashed and interned
+ObjString *allocateString(int length)
 {
-    ObjString *string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
+    ObjString *string = (ObjString *)allocateObject(STRING_SIZE(length), OBJ_STRING);
+    string->isInterned = false;
+    string->isHashed = false;
     string->length = length;
-    string->chars = chars;
+    string->hash = 0;
+    string->chars[length] = '\0';
+    return string;
+}
+
+// add a string to the intern set
+static ObjString *addInterned(ObjString *string, uint32_t hash)
+{
     string->hash = hash;
+    string->isHashed = true;
+    string->isInterned = true;
 
-    // todo: stop compiler from continuosly setting variable
-    tableSet(&vm.strings, string, NIL_VAL);
+    internSetAdd(&vm.strings, string);
     return string;
 }
 
 // returns location of string
-ObjString *takeString(char *chars, int length)
+ObjString *takeString(ObjString *string)
 {
-    uint32_t hash = hashString(chars, length);
+    uint32_t hash = stringHash(string);
 
     // return reference if string already exists
-    ObjString *interned = tableFindString(&vm.strings, chars, length, hash);
+    ObjString *interned = internSetFind(&vm.strings, string->chars, string->length, hash);
     if (interned != NULL)
     {
-        FREE_ARRAY(char, chars, length + 1);
+        freeSlot((Obj *)string);
         return interned;
     }
 
-    return allocateString(chars, length, hash);
+    return addInterned(string, hash);
+}
+
+// hash on first use, transient strings never pay for it
+uint32_t stringHash(ObjString *string)
+{
+    if (!string->isHashed)
+    {
+        string->hash = hashString(string->chars, string->length);
+        string->isHashed = true;
+    }
+
+    return string->hash;
+}
+
+// interned string with the same contents, the
+// string itself is kept since others may still use it
+ObjString *internString(ObjString *string)
+{
+    if (string->isInterned)
+        return string;
+
+    uint32_t hash = stringHash(string);
+
+    ObjString *interned = internSetFind(&vm.strings, string->chars, string->length, hash);
+    if (interned != NULL)
+        return interned;
+
+    return addInterned(string, hash);
+}
+
+// strings are equal when they're the same object, two distinct
+// interned strings never match, anything else compares bytes
+bool stringsEqual(ObjString *a, ObjString *b)
+{
+    if (a == b)
+        return true;
+
+    if ((a->isInterned && b->isInterned) || a->length != b->length)
+        return false;
+
+    // both hashes known, cheap to rule out a mismatch
+    if (a->isHashed && b->isHashed && a->hash != b->hash)
+        return false;
+
+    return charsEqual(a->chars, b->chars, a->length);
 }
 
 // copy string from source or other location into heap
@@ -92,16 +266,356 @@ ObjString *copyString(const char *chars, int length)
 {
     uint32_t hash = hashString(chars, length);
 
-    ObjString *interned = tableFindString(&vm.strings, chars, length, hash);
+    ObjString *interned = internSetFind(&vm.strings, chars, length, hash);
 
     if (interned != NULL)
         return interned;
 
-    char *heapString = ALLOCATE(char, length + 1);
-    memcpy(heapString, chars, length);
-    heapString[length] = '\0';
+    ObjString *string = allocateString(length);
+    memcpy(string->chars, chars, length);
+
+    return addInterned(string, hash);
+}
+
+// join two strings or ropes without copying them
+ObjRope *newRope(Obj *left, Obj *right)
+{
+    ObjRope *rope = ALLOCATE_OBJ(ObjRope, OBJ_ROPE);
+    rope->length = textLength(left) + textLength(right);
+    rope->left = left;
+    rope->right = right;
+    rope->flat = NULL;
+    return rope;
+}
+
+// copy a string or rope's chars to dest, recursing into the shorter
+// half and looping on the longer keeps the recursion under log2(length)
+static void flattenInto(Obj *text, char *dest)
+{
+    for (;;)
+    {
+        if (text->type != OBJ_ROPE)
+        {
+            memcpy(dest, textChars(text), textLength(text));
+            return;
+        }
+
+        ObjRope *rope = (ObjRope *)text;
+        if (rope->flat != NULL)
+        {
+            memcpy(dest, rope->flat->chars, rope->length);
+            return;
+        }
+
+        int leftLength = textLength(rope->left);
+        if (leftLength <= textLength(rope->right))
+        {
+            flattenInto(rope->left, dest);
+            dest += leftLength;
+            text = rope->right;
+        }
+        else
+        {
+            flattenInto(rope->right, dest + leftLength);
+            text = rope->left;
+        }
+    }
+}
+
+// copy a rope into a single string the first time its bytes are needed,
+// it's left uninterned until something needs that too
+ObjString *flattenRope(ObjRope *rope)
+{
+    if (rope->flat != NULL)
+        return rope->flat;
+
+    ObjString *string = allocateString(rope->length);
+    flattenInto((Obj *)rope, string->chars);
+
+    // the halves aren't needed anymore
+    rope->flat = string;
+    rope->left = NULL;
+    rope->right = NULL;
+
+    return rope->flat;
+}
+
+// part of a string sharing its chars
+static ObjSlice *newSlice(ObjString *parent, const char *chars, int length)
+{
+    ObjSlice *slice = ALLOCATE_OBJ(ObjSlice, OBJ_SLICE);
+    slice->length = length;
+    slice->chars = chars;
+    slice->parent = parent;
+    slice->string = NULL;
+    return slice;
+}
+
+// start and length must be in range, slices of slices
+// point at the original string so chains never form
+Value sliceText(Obj *text, int start, int length)
+{
+    if (start == 0 && length == textLength(text))
+        return OBJ_VAL(text);
+
+    if (length == 0)
+        return OBJ_VAL(copyString("", 0));
+
+    if (text->type == OBJ_SLICE)
+    {
+        ObjSlice *slice = (ObjSlice *)text;
+        return OBJ_VAL(newSlice(slice->parent, slice->chars + start, length));
+    }
+
+    ObjString *parent = textString(text);
+    return OBJ_VAL(newSlice(parent, parent->chars + start, length));
+}
+
+// literal left in the source instead of copied, it only
+// becomes a string of its own once something needs one
+Value sourceText(const char *chars, int length)
+{
+    if (length == 0)
+        return OBJ_VAL(copyString("", 0));
+
+    return OBJ_VAL(newSlice(NULL, chars, length));
+}
+
+// string behind any text
+ObjString *textString(Obj *text)
+{
+    switch (text->type)
+    {
+    case OBJ_ROPE:
+        return flattenRope((ObjRope *)text);
+    case OBJ_SLICE:
+    {
+        // materialize, copying only the slice's part of the parent
+        ObjSlice *slice = (ObjSlice *)text;
+        if (slice->string == NULL)
+        {
+            slice->string = allocateString(slice->length);
+            memcpy(slice->string->chars, slice->chars, slice->length);
+        }
+        return slice->string;
+    }
+    default:
+        return (ObjString *)text;
+    }
+}
+
+// chars of any text, not null terminated for slices
+const char *textChars(Obj *text)
+{
+    switch (text->type)
+    {
+    case OBJ_ROPE:
+        return flattenRope((ObjRope *)text)->chars;
+    case OBJ_SLICE:
+        return ((ObjSlice *)text)->chars;
+    default:
+        return ((ObjString *)text)->chars;
+    }
+}
+
+// compare any two texts by content
+bool textsEqual(Obj *a, Obj *b)
+{
+    if (a->type == OBJ_STRING && b->type == OBJ_STRING)
+        return stringsEqual((ObjString *)a, (ObjString *)b);
+
+    int length = textLength(a);
+    if (length != textLength(b))
+        return false;
+
+    return charsEqual(textChars(a), textChars(b), length);
+}
+
+// empty string builder, storage comes with the first append
+ObjStringBuilder *newStringBuilder()
+{
+    ObjStringBuilder *builder = ALLOCATE_OBJ(ObjStringBuilder, OBJ_STRING_BUILDER);
+    builder->length = 0;
+    builder->buffer = NULL;
+    return builder;
+}
+
+// make room for count more chars, growing geometrically
+char *builderReserve(ObjStringBuilder *builder, int count)
+{
+    int capacity = builder->buffer == NULL ? 0 : builder->buffer->length;
+    int needed = builder->length + count;
+
+    if (needed > capacity)
+    {
+        int newCapacity = GROW_CAPACITY(capacity);
+        if (newCapacity < needed)
+            newCapacity = needed;
+
+        if (builder->buffer == NULL)
+        {
+            builder->buffer = allocateString(newCapacity);
+        }
+        else
+        {
+            builder->buffer = (ObjString *)resizeObject((Obj *)builder->buffer,
+                                                        STRING_SIZE(capacity), STRING_SIZE(newCapacity));
+            builder->buffer->length = newCapacity;
+        }
+    }
+
+    return builder->buffer->chars + builder->length;
+}
+
+// copy chars onto the end of a builder
+void builderAppend(ObjStringBuilder *builder, const char *chars, int length)
+{
+    char *dest = builderReserve(builder, length);
+    memcpy(dest, chars, length);
+    builder->length += length;
+}
+
+// trim the buffer to size and intern it, large buffers
+// shrink in place so the chars aren't copied again
+ObjString *builderFinish(ObjStringBuilder *builder)
+{
+    if (builder->buffer == NULL)
+        return copyString("", 0);
+
+    ObjString *string = (ObjString *)resizeObject((Obj *)builder->buffer,
+                                                  STRING_SIZE(builder->buffer->length), STRING_SIZE(builder->length));
+    string->length = builder->length;
+    string->chars[string->length] = '\0';
+
+    builder->buffer = NULL;
+    builder->length = 0;
+
+    return takeString(string);
+}
+
+// empty map, its table allocates on the first insert
+ObjMap *newMap()
+{
+    ObjMap *map = ALLOCATE_OBJ(ObjMap, OBJ_MAP);
+    initTable(&map->table);
+    map->cursor.entry = 0;
+    map->cursor.position = 0;
+    return map;
+}
+
+// zeroed array, the values live in their own buffer
+ObjFloat64Array *newFloat64Array(int count)
+{
+    ObjFloat64Array *array = ALLOCATE_OBJ(ObjFloat64Array, OBJ_FLOAT64_ARRAY);
+    array->count = count;
+    array->values = NULL;
+    array->temporarySlot = -1;
+
+    if (count > 0)
+    {
+        array->values = ALLOCATE(double, count);
+        memset(array->values, 0, sizeof(double) * count);
+    }
+
+    return array;
+}
+
+// print the values like a list
+static void printFloat64Array(ObjFloat64Array *array)
+{
+    printf("[");
+    for (int i = 0; i < array->count; i++)
+    {
+        if (i > 0)
+            printf(", ");
+
+        printValue(NUMBER_VAL(array->values[i]));
+    }
+    printf("]");
+}
+
+// empty list, the buffer comes with the first item
+ObjList *newList()
+{
+    ObjList *list = ALLOCATE_OBJ(ObjList, OBJ_LIST);
+    initValueArray(&list->items);
+    return list;
+}
+
+// grow geometrically until count more items fit
+void listReserve(ObjList *list, int count)
+{
+    ValueArray *items = &list->items;
+    int needed = items->count + count;
+
+    if (needed > items->capacity)
+    {
+        int capacity = GROW_CAPACITY(items->capacity);
+        while (capacity < needed)
+            capacity = GROW_CAPACITY(capacity);
+
+        items->values = GROW_ARRAY(Value, items->values, items->capacity, capacity);
+        items->capacity = capacity;
+    }
+}
+
+// append a run of values with a single copy
+void listAppend(ObjList *list, const Value *values, int count)
+{
+    if (count == 0)
+        return;
+
+    listReserve(list, count);
+    memcpy(list->items.values + list->items.count, values, sizeof(Value) * count);
+    list->items.count += count;
+}
+
+// open a gap at index and fill it
+void listInsert(ObjList *list, int index, Value value)
+{
+    listReserve(list, 1);
 
-    return allocateString(heapString, length, hash);
+    Value *values = list->items.values;
+    memmove(values + index + 1, values + index, sizeof(Value) * (list->items.count - index));
+    values[index] = value;
+    list->items.count++;
+}
+
+// print a list's items in order
+static void printList(ObjList *list)
+{
+    printf("[");
+    for (int i = 0; i < list->items.count; i++)
+    {
+        if (i > 0)
+            printf(", ");
+
+        printValue(list->items.values[i]);
+    }
+    printf("]");
+}
+
+// print a map's entries in insertion order
+static void printMap(ObjMap *map)
+{
+    Table *table = &map->table;
+    bool first = true;
+
+    printf("{");
+    for (int i = 0; i < table->used; i++)
+    {
+        if (IS_HOLE(table->keys[i]))
+            continue;
+
+        if (!first)
+            printf(", ");
+        first = false;
+
+        printValue(table->keys[i]);
+        printf(": ");
+        printValue(table->values[i]);
+    }
+    printf("}");
 }
 
 // allow blue lang to print functions
@@ -131,5 +645,32 @@ void printObject(Value value)
     case OBJ_STRING:
         printf("%s", AS_CSTRING(value));
         break;
+    case OBJ_ROPE:
+        printf("%s", flattenRope(AS_ROPE(value))->chars);
+        break;
+    case OBJ_SLICE:
+        printf("%.*s", AS_SLICE(value)->length, textChars(AS_OBJ(value)));
+        break;
+    case OBJ_STRING_BUILDER:
+        printf("<string builder>");
+        break;
+    case OBJ_MAP:
+        printMap(AS_MAP(value));
+        break;
+    case OBJ_LIST:
+        printList(AS_LIST(value));
+        break;
+    case OBJ_FLOAT64_ARRAY:
+        printFloat64Array(AS_FLOAT64_ARRAY(value));
+        break;
+    case OBJ_PERSISTENT_MAP:
+        printPersistentMap(AS_PERSISTENT_MAP(value));
+        break;
+    case OBJ_PERSISTENT_VECTOR:
+        printPersistentVector(AS_PERSISTENT_VECTOR(value));
+        break;
+    case OBJ_TRIE_NODE:
+        printf("<trie node>");
+        break;
     }
 }
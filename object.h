@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "chunk.h"
+#include "table.h"
 #include "value.h"
 
 #define OBJ_TYPE(item) (AS_OBJ(item)->type)
@@ -10,12 +11,39 @@
 #define IS_FUNCTION(item) isObjType(item, OBJ_FUNCTION)
 #define IS_NATIVE(item) isObjType(item, OBJ_NATIVE);
 #define IS_STRING(item) isObjType(item, OBJ_STRING)
+#define IS_ROPE(item) isObjType(item, OBJ_ROPE)
+#define IS_SLICE(item) isObjType(item, OBJ_SLICE)
+#define IS_STRING_BUILDER(item) isObjType(item, OBJ_STRING_BUILDER)
+#define IS_MAP(item) isObjType(item, OBJ_MAP)
+#define IS_LIST(item) isObjType(item, OBJ_LIST)
+#define IS_FLOAT64_ARRAY(item) isObjType(item, OBJ_FLOAT64_ARRAY)
+#define IS_PERSISTENT_MAP(item) isObjType(item, OBJ_PERSISTENT_MAP)
+#define IS_PERSISTENT_VECTOR(item) isObjType(item, OBJ_PERSISTENT_VECTOR)
 
 #define AS_FUNCTION(item) ((ObjFunction *)AS_OBJ(item))
 #define AS_NATIVE(item) \
     (((ObjNative *)AS_OBJ(item))->function)
 #define AS_STRING(item) ((ObjString *)AS_OBJ(item))
 #define AS_CSTRING(item) (((ObjString *)AS_OBJ(item))->chars)
+#define AS_ROPE(item) ((ObjRope *)AS_OBJ(item))
+#define AS_SLICE(item) ((ObjSlice *)AS_OBJ(item))
+#define AS_STRING_BUILDER(item) ((ObjStringBuilder *)AS_OBJ(item))
+#define AS_MAP(item) ((ObjMap *)AS_OBJ(item))
+#define AS_LIST(item) ((ObjList *)AS_OBJ(item))
+#define AS_FLOAT64_ARRAY(item) ((ObjFloat64Array *)AS_OBJ(item))
+#define AS_PERSISTENT_MAP(item) ((ObjPersistentMap *)AS_OBJ(item))
+#define AS_PERSISTENT_VECTOR(item) ((ObjPersistentVector *)AS_OBJ(item))
+#define AS_TRIE_NODE(item) ((ObjTrieNode *)AS_OBJ(item))
+
+// heap size of a string storing length chars and the null terminator
+#define STRING_SIZE(length) (sizeof(ObjString) + (length) + 1)
+
+// heap size of a trie node with room for capacity slots
+#define TRIE_NODE_SIZE(capacity) (sizeof(ObjTrieNode) + sizeof(Value) * (capacity))
+
+// concatenations shorter than this are copied right away,
+// longer ones become ropes and are only copied when needed
+#define ROPE_MIN_LENGTH 64
 
 // types of objects for blue
 typedef enum
@@ -23,16 +51,26 @@ typedef enum
     OBJ_FUNCTION,
     OBJ_NATIVE,
     OBJ_STRING,
+    OBJ_ROPE,
+    OBJ_SLICE,
+    OBJ_STRING_BUILDER,
+    OBJ_MAP,
+    OBJ_LIST,
+    OBJ_FLOAT64_ARRAY,
+    OBJ_PERSISTENT_MAP,
+    OBJ_PERSISTENT_VECTOR,
+    OBJ_TRIE_NODE,
 } ObjType;
 
+// one past the last ObjType, sizes the heap's per type page lists
+#define OBJ_TYPE_COUNT (OBJ_TRIE_NODE + 1)
+
 // each blue object will inherit this struct
-// to define its type and possibly other fields
+// to define its type and possibly other fields,
+// the heap tracks objects and mark bits in its pages
 struct Obj
 {
-    ObjType type;
-
-    // linked list node of all objects
-    struct Obj *next;
+    uint8_t type;
 };
 
 // code chunk representation of a Blue function
@@ -57,27 +95,232 @@ typedef struct
     NativeFunc function;
 } ObjNative;
 
-// extends obj and adds string properties
+// extends obj and adds string properties,
+// the characters live inline right after the header
 struct ObjString
 {
     Obj obj;
+
+    // strings built at runtime are only hashed and
+    // interned once something needs them to be
+    bool isInterned;
+    bool isHashed;
+
     int length;
-    char *chars;
     uint32_t hash;
+    char chars[];
 };
 
+// string made by concatenation that hasn't been copied yet,
+// each half is an ObjString or another ObjRope
+typedef struct
+{
+    Obj obj;
+    int length;
+
+    // halves, both NULL once flattened
+    Obj *left;
+    Obj *right;
+
+    // the joined string once something needed its bytes
+    ObjString *flat;
+} ObjRope;
+
+// part of a string that shares its parent's chars instead of copying them,
+// string literals are slices of the source the vm keeps alive
+typedef struct
+{
+    Obj obj;
+    int length;
+
+    // first char, inside the parent or inside the source when parent is NULL
+    const char *chars;
+    ObjString *parent;
+
+    // own copy, made once the slice has to be a real string
+    ObjString *string;
+} ObjSlice;
+
+// mutable buffer for building up a string, appends are amortized O(1)
+typedef struct
+{
+    Obj obj;
+
+    // chars written so far
+    int length;
+
+    // storage, a string whose length is the capacity so it can
+    // become the finished string without copying; NULL until used
+    ObjString *buffer;
+} ObjStringBuilder;
+
+// hash map from any value to any value, iterates in insertion order
+typedef struct
+{
+    Obj obj;
+    Table table;
+
+    // last place keyAt or valueAt looked up
+    TableCursor cursor;
+} ObjMap;
+
+// growable array of values, stored contiguously
+typedef struct
+{
+    Obj obj;
+    ValueArray items;
+} ObjList;
+
+// fixed length array of raw doubles, 8 bytes an item with no type
+// tags so the kernels in kernels.c can run over it directly
+typedef struct
+{
+    Obj obj;
+    int count;
+    double *values;
+
+    // stack slot of an arithmetic result that hasn't been stored
+    // anywhere else yet, so the next operator can write into it;
+    // -1 once anything else may see the array
+    int temporarySlot;
+} ObjFloat64Array;
+
+// node of a persistent map or vector, shared by every version that
+// reaches it; only the transient whose edit id it carries may change it
+typedef struct
+{
+    Obj obj;
+
+    // transient that made the node, 0 once nothing may change it
+    uint32_t edit;
+
+    // map nodes: which of the 32 hash slices have an entry,
+    // unused by collision nodes and vector nodes
+    uint32_t bitmap;
+
+    // entries in use, key/value pairs in map nodes and values or
+    // children in vector nodes, and the slots allocated for them
+    int count;
+    int capacity;
+
+    // a map entry whose key is a hole holds a child node as its value
+    Value slots[];
+} ObjTrieNode;
+
+// immutable hash array mapped trie, updates copy only the path to
+// the changed entry; a transient updates its own nodes in place
+typedef struct
+{
+    Obj obj;
+    int count;
+
+    // NULL while empty
+    ObjTrieNode *root;
+
+    // transients get a fresh edit id, made persistent again
+    // it drops to 0 and the transient can't be used any more
+    bool isTransient;
+    uint32_t edit;
+} ObjPersistentMap;
+
+// immutable vector, a trie 32 wide with the last 32 values kept
+// in a separate tail so appends rarely touch the trie
+typedef struct
+{
+    Obj obj;
+    int count;
+
+    // bits the root's index is shifted by, 5 per level
+    int shift;
+    ObjTrieNode *root;
+    ObjTrieNode *tail;
+
+    bool isTransient;
+    uint32_t edit;
+} ObjPersistentVector;
+
 // c function to declare byte code function
 ObjFunction *newFunction();
 
 // native C functions, callable in Blue
 ObjNative *newNative(NativeFunc function);
 
-// passes ownership of string by making a copy
-ObjString *takeString(char *chars, int length);
+// reserve a string with room for length chars, fill chars then either pass
+// it to takeString or use it as is, a runtime string that isn't interned yet
+ObjString *allocateString(int length);
+
+// interns a string made by allocateString, frees it if it already exists
+ObjString *takeString(ObjString *string);
+
+// hash of a string, computed the first time it's asked for
+uint32_t stringHash(ObjString *string);
+
+// interned copy of a string, for when it's used as a table key
+ObjString *internString(ObjString *string);
+
+// hash of length chars, the one strings are interned by
+uint32_t hashString(const char *key, int length);
+
+// compare length bytes, 16 at a time where SSE2 is available
+bool charsEqual(const char *a, const char *b, int length);
+
+// compare by content unless both are interned
+bool stringsEqual(ObjString *a, ObjString *b);
 
 // clone a string
 ObjString *copyString(const char *chars, int length);
 
+// string literal pointing at chars in source the vm keeps alive
+Value sourceText(const char *chars, int length);
+
+// join two strings or ropes without copying them
+ObjRope *newRope(Obj *left, Obj *right);
+
+// copy a rope's pieces into one string, cached on the rope
+ObjString *flattenRope(ObjRope *rope);
+
+// substring of a string, rope or slice without copying chars
+Value sliceText(Obj *text, int start, int length);
+
+// string behind any text, flattening ropes and copying slices
+ObjString *textString(Obj *text);
+
+// chars of any text, only ropes have to be flattened
+const char *textChars(Obj *text);
+
+// compare any two texts by content
+bool textsEqual(Obj *a, Obj *b);
+
+// empty string builder
+ObjStringBuilder *newStringBuilder();
+
+// room for at least count more chars, returns where they go
+char *builderReserve(ObjStringBuilder *builder, int count);
+
+// append chars to a builder
+void builderAppend(ObjStringBuilder *builder, const char *chars, int length);
+
+// hand the buffer over as an interned string, leaves the builder empty
+ObjString *builderFinish(ObjStringBuilder *builder);
+
+// empty map
+ObjMap *newMap();
+
+// array of count zeros
+ObjFloat64Array *newFloat64Array(int count);
+
+// empty list
+ObjList *newList();
+
+// make room for count more items, growing the buffer once
+void listReserve(ObjList *list, int count);
+
+// copy count values onto the end of a list
+void listAppend(ObjList *list, const Value *values, int count);
+
+// put a value at index, moving the items after it up, index may be the count
+void listInsert(ObjList *list, int index, Value value);
+
 // handle object printing
 void printObject(Value value);
 
@@ -87,6 +330,30 @@ static inline bool isObjType(Value value, ObjType type)
     return IS_OBJ(value) && AS_OBJ(value)->type == type;
 }
 
+// string, rope or slice
+static inline bool isText(Value value)
+{
+    if (!IS_OBJ(value))
+        return false;
+
+    ObjType type = AS_OBJ(value)->type;
+    return type == OBJ_STRING || type == OBJ_ROPE || type == OBJ_SLICE;
+}
+
+// number of chars in a string, rope or slice
+static inline int textLength(Obj *text)
+{
+    switch (text->type)
+    {
+    case OBJ_ROPE:
+        return ((ObjRope *)text)->length;
+    case OBJ_SLICE:
+        return ((ObjSlice *)text)->length;
+    default:
+        return ((ObjString *)text)->length;
+    }
+}
+
 // todo: support converting any object into a string
 
 #endif
@@ -0,0 +1,778 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "object.h"
+#include "persistent.h"
+#include "table.h"
+#include "value.h"
+
+// bagwell, "ideal hash trees", and the bit partitioned vectors clojure
+// builds on them: 32 way tries where an update copies the nodes on the
+// path to the change and shares the rest with the version it came from
+
+#define TRIE_BITS 5
+#define TRIE_WIDTH (1 << TRIE_BITS)
+#define TRIE_MASK (TRIE_WIDTH - 1)
+
+// deepest map level with hash bits left, keys whose 32 bit hashes are
+// all equal end up together in a collision node below it
+#define HAMT_MAX_SHIFT 30
+
+// bit for the hash's slice at a map level, and the pair it sits at
+#define HAMT_BIT(hash, shift) ((uint32_t)1 << (((hash) >> (shift)) & TRIE_MASK))
+#define HAMT_INDEX(bitmap, bit) __builtin_popcount((bitmap) & ((bit)-1))
+
+// extra slots a transient's map nodes get so inserts can land in place
+#define TRANSIENT_SLACK 4
+
+#define ALLOCATE_OBJ(type, objectType) (type *)allocateObject(sizeof(type), objectType)
+
+// ids handed to transients, 0 means a node belongs to no transient
+static uint32_t nextEdit = 1;
+
+static ObjTrieNode *newNode(uint32_t edit, int capacity)
+{
+    ObjTrieNode *node = (ObjTrieNode *)allocateObject(TRIE_NODE_SIZE(capacity), OBJ_TRIE_NODE);
+    node->edit = edit;
+    node->bitmap = 0;
+    node->count = 0;
+    node->capacity = capacity;
+    return node;
+}
+
+// node edit may change with room for capacity slots, used of which are
+// taken: a transient's own node is changed where it is, anything else
+// is copied and the copy belongs to edit
+static ObjTrieNode *editable(ObjTrieNode *node, uint32_t edit, int used, int capacity)
+{
+    if (edit != 0 && node->edit == edit)
+    {
+        if (node->capacity >= capacity)
+            return node;
+
+        // only the transient points at its own nodes, so it can move
+        node = (ObjTrieNode *)resizeObject((Obj *)node, TRIE_NODE_SIZE(node->capacity), TRIE_NODE_SIZE(capacity));
+        node->capacity = capacity;
+        return node;
+    }
+
+    ObjTrieNode *copy = newNode(edit, capacity);
+    copy->bitmap = node->bitmap;
+    copy->count = node->count;
+    memcpy(copy->slots, node->slots, sizeof(Value) * used);
+    return copy;
+}
+
+// slots for a map node of pairs entries, leaving transients room to grow
+static inline int mapCapacity(uint32_t edit, int pairs)
+{
+    return pairs * 2 + (edit != 0 ? TRANSIENT_SLACK : 0);
+}
+
+// slots for a vector node of count entries, transients fill theirs up
+static inline int vectorCapacity(uint32_t edit, int count)
+{
+    return edit != 0 ? TRIE_WIDTH : count;
+}
+
+// map
+
+ObjPersistentMap *newPersistentMap()
+{
+    ObjPersistentMap *map = ALLOCATE_OBJ(ObjPersistentMap, OBJ_PERSISTENT_MAP);
+    map->count = 0;
+    map->root = NULL;
+    map->isTransient = false;
+    map->edit = 0;
+    return map;
+}
+
+static ObjPersistentMap *makeMap(ObjTrieNode *root, int count)
+{
+    ObjPersistentMap *map = newPersistentMap();
+    map->root = root;
+    map->count = count;
+    return map;
+}
+
+// walk down the slices of the hash, one level per 5 bits
+static bool nodeGet(ObjTrieNode *node, int shift, uint32_t hash, Value key, Value *value)
+{
+    while (shift <= HAMT_MAX_SHIFT)
+    {
+        uint32_t bit = HAMT_BIT(hash, shift);
+        if ((node->bitmap & bit) == 0)
+            return false;
+
+        Value *pair = &node->slots[HAMT_INDEX(node->bitmap, bit) * 2];
+        if (!IS_HOLE(pair[0]))
+        {
+            if (!tableKeysEqual(pair[0], key))
+                return false;
+
+            *value = pair[1];
+            return true;
+        }
+
+        node = AS_TRIE_NODE(pair[1]);
+        shift += TRIE_BITS;
+    }
+
+    // collision node, every key has the same hash
+    for (int i = 0; i < node->count; i++)
+    {
+        if (tableKeysEqual(node->slots[i * 2], key))
+        {
+            *value = node->slots[i * 2 + 1];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// node holding two keys that shared a slice one level up
+static ObjTrieNode *pairNode(uint32_t edit, int shift, Value key1, Value value1, uint32_t hash1,
+                             Value key2, Value value2, uint32_t hash2)
+{
+    ObjTrieNode *node = newNode(edit, mapCapacity(edit, 2));
+    node->count = 2;
+
+    if (shift > HAMT_MAX_SHIFT)
+    {
+        node->slots[0] = key1;
+        node->slots[1] = value1;
+        node->slots[2] = key2;
+        node->slots[3] = value2;
+        return node;
+    }
+
+    uint32_t bit1 = HAMT_BIT(hash1, shift);
+    uint32_t bit2 = HAMT_BIT(hash2, shift);
+
+    if (bit1 == bit2)
+    {
+        // still together, go down another level
+        node->count = 1;
+        node->bitmap = bit1;
+        node->slots[0] = HOLE_VAL;
+        node->slots[1] = OBJ_VAL(pairNode(edit, shift + TRIE_BITS, key1, value1, hash1, key2, value2, hash2));
+        return node;
+    }
+
+    node->bitmap = bit1 | bit2;
+    int first = bit1 < bit2 ? 0 : 2;
+    node->slots[first] = key1;
+    node->slots[first + 1] = value1;
+    node->slots[2 - first] = key2;
+    node->slots[3 - first] = value2;
+    return node;
+}
+
+// key set in a collision node
+static ObjTrieNode *collisionPut(ObjTrieNode *node, uint32_t edit, Value key, Value value, bool *added)
+{
+    int used = node->count * 2;
+
+    for (int i = 0; i < used; i += 2)
+    {
+        if (tableKeysEqual(node->slots[i], key))
+        {
+            if (tableKeysEqual(node->slots[i + 1], value))
+                return node;
+
+            node = editable(node, edit, used, mapCapacity(edit, node->count));
+            node->slots[i + 1] = value;
+            return node;
+        }
+    }
+
+    *added = true;
+    node = editable(node, edit, used, mapCapacity(edit, node->count + 1));
+    node->slots[used] = key;
+    node->slots[used + 1] = value;
+    node->count++;
+    return node;
+}
+
+// node with key set, the node itself when nothing changed
+static ObjTrieNode *nodePut(ObjTrieNode *node, uint32_t edit, int shift, uint32_t hash,
+                            Value key, Value value, bool *added)
+{
+    if (shift > HAMT_MAX_SHIFT)
+        return collisionPut(node, edit, key, value, added);
+
+    uint32_t bit = HAMT_BIT(hash, shift);
+    int index = HAMT_INDEX(node->bitmap, bit) * 2;
+    int used = node->count * 2;
+
+    if ((node->bitmap & bit) == 0)
+    {
+        // free slice, open a gap for the pair
+        *added = true;
+        node = editable(node, edit, used, mapCapacity(edit, node->count + 1));
+        memmove(&node->slots[index + 2], &node->slots[index], sizeof(Value) * (used - index));
+        node->slots[index] = key;
+        node->slots[index + 1] = value;
+        node->bitmap |= bit;
+        node->count++;
+        return node;
+    }
+
+    Value slotKey = node->slots[index];
+    Value slotValue = node->slots[index + 1];
+
+    if (IS_HOLE(slotKey))
+    {
+        ObjTrieNode *child = AS_TRIE_NODE(slotValue);
+        ObjTrieNode *newChild = nodePut(child, edit, shift + TRIE_BITS, hash, key, value, added);
+        if (newChild == child)
+            return node;
+
+        node = editable(node, edit, used, mapCapacity(edit, node->count));
+        node->slots[index + 1] = OBJ_VAL(newChild);
+        return node;
+    }
+
+    if (tableKeysEqual(slotKey, key))
+    {
+        if (tableKeysEqual(slotValue, value))
+            return node;
+
+        node = editable(node, edit, used, mapCapacity(edit, node->count));
+        node->slots[index + 1] = value;
+        return node;
+    }
+
+    // another key holds the slice, both move down a level
+    *added = true;
+    ObjTrieNode *child = pairNode(edit, shift + TRIE_BITS, slotKey, slotValue, tableKeyHash(slotKey),
+                                  key, value, hash);
+
+    node = editable(node, edit, used, mapCapacity(edit, node->count));
+    node->slots[index] = HOLE_VAL;
+    node->slots[index + 1] = OBJ_VAL(child);
+    return node;
+}
+
+// node without key, NULL once it's empty
+static ObjTrieNode *nodeRemove(ObjTrieNode *node, uint32_t edit, int shift, uint32_t hash,
+                               Value key, bool *removed)
+{
+    int used = node->count * 2;
+    uint32_t bit = 0;
+    int index;
+
+    if (shift > HAMT_MAX_SHIFT)
+    {
+        for (index = 0; index < used; index += 2)
+        {
+            if (tableKeysEqual(node->slots[index], key))
+                break;
+        }
+
+        if (index == used)
+            return node;
+
+        *removed = true;
+    }
+    else
+    {
+        bit = HAMT_BIT(hash, shift);
+        if ((node->bitmap & bit) == 0)
+            return node;
+
+        index = HAMT_INDEX(node->bitmap, bit) * 2;
+        Value slotKey = node->slots[index];
+
+        if (IS_HOLE(slotKey))
+        {
+            ObjTrieNode *child = AS_TRIE_NODE(node->slots[index + 1]);
+            ObjTrieNode *newChild = nodeRemove(child, edit, shift + TRIE_BITS, hash, key, removed);
+            if (!*removed)
+                return node;
+
+            if (newChild != NULL)
+            {
+                node = editable(node, edit, used, mapCapacity(edit, node->count));
+
+                // a child down to one pair gives it back to this level
+                if (newChild->count == 1 && !IS_HOLE(newChild->slots[0]))
+                {
+                    node->slots[index] = newChild->slots[0];
+                    node->slots[index + 1] = newChild->slots[1];
+                }
+                else
+                {
+                    node->slots[index + 1] = OBJ_VAL(newChild);
+                }
+
+                return node;
+            }
+        }
+        else if (!tableKeysEqual(slotKey, key))
+        {
+            return node;
+        }
+
+        *removed = true;
+    }
+
+    if (node->count == 1)
+        return NULL;
+
+    node = editable(node, edit, used, mapCapacity(edit, node->count));
+    memmove(&node->slots[index], &node->slots[index + 2], sizeof(Value) * (used - index - 2));
+    node->bitmap &= ~bit;
+    node->count--;
+    return node;
+}
+
+bool persistentMapGet(ObjPersistentMap *map, Value key, Value *value)
+{
+    if (map->root == NULL)
+        return false;
+
+    key = tableKey(key);
+    return nodeGet(map->root, 0, tableKeyHash(key), key, value);
+}
+
+ObjPersistentMap *persistentMapPut(ObjPersistentMap *map, Value key, Value value)
+{
+    key = tableKey(key);
+    uint32_t hash = tableKeyHash(key);
+    bool added = false;
+    ObjTrieNode *root;
+
+    if (map->root == NULL)
+    {
+        root = newNode(map->edit, mapCapacity(map->edit, 1));
+        root->bitmap = HAMT_BIT(hash, 0);
+        root->count = 1;
+        root->slots[0] = key;
+        root->slots[1] = value;
+        added = true;
+    }
+    else
+    {
+        root = nodePut(map->root, map->edit, 0, hash, key, value, &added);
+    }
+
+    if (map->isTransient)
+    {
+        map->root = root;
+        map->count += added;
+        return map;
+    }
+
+    if (root == map->root)
+        return map;
+
+    return makeMap(root, map->count + added);
+}
+
+ObjPersistentMap *persistentMapRemove(ObjPersistentMap *map, Value key)
+{
+    if (map->root == NULL)
+        return map;
+
+    key = tableKey(key);
+    bool removed = false;
+    ObjTrieNode *root = nodeRemove(map->root, map->edit, 0, tableKeyHash(key), key, &removed);
+
+    if (!removed)
+        return map;
+
+    if (map->isTransient)
+    {
+        map->root = root;
+        map->count--;
+        return map;
+    }
+
+    return makeMap(root, map->count - 1);
+}
+
+// push a node's keys or values onto a transient vector
+static ObjPersistentVector *collectNode(ObjTrieNode *node, int part, ObjPersistentVector *into)
+{
+    for (int i = 0; i < node->count * 2; i += 2)
+    {
+        if (IS_HOLE(node->slots[i]))
+            into = collectNode(AS_TRIE_NODE(node->slots[i + 1]), part, into);
+        else
+            into = persistentVectorPush(into, node->slots[i + part]);
+    }
+
+    return into;
+}
+
+static ObjPersistentVector *collectMap(ObjPersistentMap *map, int part)
+{
+    ObjPersistentVector *vector = (ObjPersistentVector *)transientOf((Obj *)newPersistentVector());
+
+    if (map->root != NULL)
+        vector = collectNode(map->root, part, vector);
+
+    return (ObjPersistentVector *)persistentOf((Obj *)vector);
+}
+
+ObjPersistentVector *persistentMapKeys(ObjPersistentMap *map)
+{
+    return collectMap(map, 0);
+}
+
+ObjPersistentVector *persistentMapValues(ObjPersistentMap *map)
+{
+    return collectMap(map, 1);
+}
+
+// vector
+
+ObjPersistentVector *newPersistentVector()
+{
+    ObjPersistentVector *vector = ALLOCATE_OBJ(ObjPersistentVector, OBJ_PERSISTENT_VECTOR);
+    vector->count = 0;
+    vector->shift = TRIE_BITS;
+    vector->root = NULL;
+    vector->tail = NULL;
+    vector->isTransient = false;
+    vector->edit = 0;
+    return vector;
+}
+
+static ObjPersistentVector *makeVector(int count, int shift, ObjTrieNode *root, ObjTrieNode *tail)
+{
+    ObjPersistentVector *vector = newPersistentVector();
+    vector->count = count;
+    vector->shift = shift;
+    vector->root = root;
+    vector->tail = tail;
+    return vector;
+}
+
+// index of the first value in the tail
+static inline int tailOffset(int count)
+{
+    return count < TRIE_WIDTH ? 0 : ((count - 1) >> TRIE_BITS) << TRIE_BITS;
+}
+
+// leaf holding index
+static ObjTrieNode *leafFor(ObjPersistentVector *vector, int index)
+{
+    if (index >= tailOffset(vector->count))
+        return vector->tail;
+
+    ObjTrieNode *node = vector->root;
+    for (int level = vector->shift; level > 0; level -= TRIE_BITS)
+        node = AS_TRIE_NODE(node->slots[(index >> level) & TRIE_MASK]);
+
+    return node;
+}
+
+Value persistentVectorGet(ObjPersistentVector *vector, int index)
+{
+    return leafFor(vector, index)->slots[index & TRIE_MASK];
+}
+
+// copy of the path down to index with its value replaced
+static ObjTrieNode *setPath(ObjTrieNode *node, uint32_t edit, int level, int index, Value value)
+{
+    node = editable(node, edit, node->count, vectorCapacity(edit, node->count));
+
+    if (level == 0)
+    {
+        node->slots[index & TRIE_MASK] = value;
+    }
+    else
+    {
+        int slot = (index >> level) & TRIE_MASK;
+        ObjTrieNode *child = setPath(AS_TRIE_NODE(node->slots[slot]), edit, level - TRIE_BITS, index, value);
+        node->slots[slot] = OBJ_VAL(child);
+    }
+
+    return node;
+}
+
+ObjPersistentVector *persistentVectorSet(ObjPersistentVector *vector, int index, Value value)
+{
+    uint32_t edit = vector->edit;
+    ObjTrieNode *root = vector->root;
+    ObjTrieNode *tail = vector->tail;
+
+    if (index >= tailOffset(vector->count))
+    {
+        tail = editable(tail, edit, tail->count, vectorCapacity(edit, tail->count));
+        tail->slots[index & TRIE_MASK] = value;
+    }
+    else
+    {
+        root = setPath(root, edit, vector->shift, index, value);
+    }
+
+    if (vector->isTransient)
+    {
+        vector->root = root;
+        vector->tail = tail;
+        return vector;
+    }
+
+    return makeVector(vector->count, vector->shift, root, tail);
+}
+
+// chain of single child nodes down to a leaf
+static ObjTrieNode *newPath(uint32_t edit, int level, ObjTrieNode *leaf)
+{
+    if (level == 0)
+        return leaf;
+
+    ObjTrieNode *node = newNode(edit, vectorCapacity(edit, 1));
+    node->slots[0] = OBJ_VAL(newPath(edit, level - TRIE_BITS, leaf));
+    node->count = 1;
+    return node;
+}
+
+// copy of the path to the leaf after the last one, with a full tail there;
+// count is the vector's count including the tail
+static ObjTrieNode *pushTail(ObjTrieNode *node, uint32_t edit, int level, int count, ObjTrieNode *tail)
+{
+    int slot = ((count - 1) >> level) & TRIE_MASK;
+    ObjTrieNode *child;
+
+    if (level == TRIE_BITS)
+        child = tail;
+    else if (slot < node->count)
+        child = pushTail(AS_TRIE_NODE(node->slots[slot]), edit, level - TRIE_BITS, count, tail);
+    else
+        child = newPath(edit, level - TRIE_BITS, tail);
+
+    int needed = slot < node->count ? node->count : slot + 1;
+    node = editable(node, edit, node->count, vectorCapacity(edit, needed));
+    node->slots[slot] = OBJ_VAL(child);
+    node->count = needed;
+    return node;
+}
+
+ObjPersistentVector *persistentVectorPush(ObjPersistentVector *vector, Value value)
+{
+    uint32_t edit = vector->edit;
+    int count = vector->count;
+    int shift = vector->shift;
+    ObjTrieNode *root = vector->root;
+    ObjTrieNode *tail = vector->tail;
+
+    if (tail == NULL)
+    {
+        tail = newNode(edit, vectorCapacity(edit, 1));
+    }
+    else if (count - tailOffset(count) < TRIE_WIDTH)
+    {
+        tail = editable(tail, edit, tail->count, vectorCapacity(edit, tail->count + 1));
+    }
+    else
+    {
+        // the full tail moves into the trie, a new root level
+        // is added once the current one can't hold it
+        if ((count >> TRIE_BITS) > (1 << shift))
+        {
+            ObjTrieNode *newRoot = newNode(edit, vectorCapacity(edit, 2));
+            newRoot->slots[0] = OBJ_VAL(root);
+            newRoot->slots[1] = OBJ_VAL(newPath(edit, shift, tail));
+            newRoot->count = 2;
+            root = newRoot;
+            shift += TRIE_BITS;
+        }
+        else
+        {
+            if (root == NULL)
+                root = newNode(edit, vectorCapacity(edit, 1));
+
+            root = pushTail(root, edit, shift, count, tail);
+        }
+
+        tail = newNode(edit, vectorCapacity(edit, 1));
+    }
+
+    tail->slots[tail->count++] = value;
+
+    if (vector->isTransient)
+    {
+        vector->count++;
+        vector->shift = shift;
+        vector->root = root;
+        vector->tail = tail;
+        return vector;
+    }
+
+    return makeVector(count + 1, shift, root, tail);
+}
+
+// copy of the path to the last leaf with that leaf removed,
+// NULL when nothing is left below node
+static ObjTrieNode *popTail(ObjTrieNode *node, uint32_t edit, int level, int count)
+{
+    int slot = ((count - 2) >> level) & TRIE_MASK;
+
+    if (level > TRIE_BITS)
+    {
+        ObjTrieNode *child = popTail(AS_TRIE_NODE(node->slots[slot]), edit, level - TRIE_BITS, count);
+        if (child == NULL && slot == 0)
+            return NULL;
+
+        node = editable(node, edit, node->count, vectorCapacity(edit, node->count));
+        if (child == NULL)
+            node->count = slot;
+        else
+            node->slots[slot] = OBJ_VAL(child);
+
+        return node;
+    }
+
+    if (slot == 0)
+        return NULL;
+
+    node = editable(node, edit, node->count, vectorCapacity(edit, node->count));
+    node->count = slot;
+    return node;
+}
+
+ObjPersistentVector *persistentVectorPop(ObjPersistentVector *vector)
+{
+    uint32_t edit = vector->edit;
+    int count = vector->count;
+    int shift = vector->shift;
+    ObjTrieNode *root = vector->root;
+    ObjTrieNode *tail = vector->tail;
+
+    if (count == 1)
+    {
+        root = NULL;
+        tail = NULL;
+        shift = TRIE_BITS;
+    }
+    else if (count - tailOffset(count) > 1)
+    {
+        tail = editable(tail, edit, tail->count, vectorCapacity(edit, tail->count));
+        tail->count--;
+    }
+    else
+    {
+        // the tail empties, the last leaf of the trie takes its place
+        tail = leafFor(vector, count - 2);
+        root = popTail(root, edit, shift, count);
+
+        if (shift > TRIE_BITS && root->count == 1)
+        {
+            root = AS_TRIE_NODE(root->slots[0]);
+            shift -= TRIE_BITS;
+        }
+    }
+
+    if (vector->isTransient)
+    {
+        vector->count--;
+        vector->shift = shift;
+        vector->root = root;
+        vector->tail = tail;
+        return vector;
+    }
+
+    return makeVector(count - 1, shift, root, tail);
+}
+
+// transients
+
+Obj *transientOf(Obj *collection)
+{
+    uint32_t edit = nextEdit++;
+    if (nextEdit == 0)
+        nextEdit = 1;
+
+    if (collection->type == OBJ_PERSISTENT_MAP)
+    {
+        ObjPersistentMap *from = (ObjPersistentMap *)collection;
+        ObjPersistentMap *map = makeMap(from->root, from->count);
+        map->isTransient = true;
+        map->edit = edit;
+        return (Obj *)map;
+    }
+
+    ObjPersistentVector *from = (ObjPersistentVector *)collection;
+    ObjPersistentVector *vector = makeVector(from->count, from->shift, from->root, from->tail);
+    vector->isTransient = true;
+    vector->edit = edit;
+    return (Obj *)vector;
+}
+
+Obj *persistentOf(Obj *transient)
+{
+    // the nodes keep the old id, with nobody holding it they're frozen
+    if (transient->type == OBJ_PERSISTENT_MAP)
+    {
+        ObjPersistentMap *from = (ObjPersistentMap *)transient;
+        from->edit = 0;
+        return (Obj *)makeMap(from->root, from->count);
+    }
+
+    ObjPersistentVector *from = (ObjPersistentVector *)transient;
+    from->edit = 0;
+    return (Obj *)makeVector(from->count, from->shift, from->root, from->tail);
+}
+
+bool isSpentTransient(Obj *collection)
+{
+    if (collection->type == OBJ_PERSISTENT_MAP)
+    {
+        ObjPersistentMap *map = (ObjPersistentMap *)collection;
+        return map->isTransient && map->edit == 0;
+    }
+
+    ObjPersistentVector *vector = (ObjPersistentVector *)collection;
+    return vector->isTransient && vector->edit == 0;
+}
+
+// printing
+
+static void printNode(ObjTrieNode *node, bool *first)
+{
+    for (int i = 0; i < node->count * 2; i += 2)
+    {
+        if (IS_HOLE(node->slots[i]))
+        {
+            printNode(AS_TRIE_NODE(node->slots[i + 1]), first);
+            continue;
+        }
+
+        if (!*first)
+            printf(", ");
+        *first = false;
+
+        printValue(node->slots[i]);
+        printf(": ");
+        printValue(node->slots[i + 1]);
+    }
+}
+
+void printPersistentMap(ObjPersistentMap *map)
+{
+    bool first = true;
+
+    printf("{");
+    if (map->root != NULL)
+        printNode(map->root, &first);
+    printf("}");
+}
+
+void printPersistentVector(ObjPersistentVector *vector)
+{
+    printf("[");
+    for (int i = 0; i < vector->count; i++)
+    {
+        if (i > 0)
+            printf(", ");
+
+        printValue(persistentVectorGet(vector, i));
+    }
+    printf("]");
+}
@@ -0,0 +1,57 @@
+#ifndef blue_persistent_h
+#define blue_persistent_h
+
+#include "common.h"
+#include "object.h"
+#include "value.h"
+
+// updates to a persistent collection return a new version and leave
+// the old one alone, unless the collection is a transient: then it is
+// changed in place and returned
+
+// empty map
+ObjPersistentMap *newPersistentMap();
+
+// look a key up, keys are matched the way tables match them
+bool persistentMapGet(ObjPersistentMap *map, Value key, Value *value);
+
+// map with key set to value
+ObjPersistentMap *persistentMapPut(ObjPersistentMap *map, Value key, Value value);
+
+// map without key
+ObjPersistentMap *persistentMapRemove(ObjPersistentMap *map, Value key);
+
+// vector of the map's keys or values, in the map's own order
+ObjPersistentVector *persistentMapKeys(ObjPersistentMap *map);
+ObjPersistentVector *persistentMapValues(ObjPersistentMap *map);
+
+// empty vector
+ObjPersistentVector *newPersistentVector();
+
+// value at index, which must be below count
+Value persistentVectorGet(ObjPersistentVector *vector, int index);
+
+// vector with the value at index replaced, index must be below count
+ObjPersistentVector *persistentVectorSet(ObjPersistentVector *vector, int index, Value value);
+
+// vector with value added to the end
+ObjPersistentVector *persistentVectorPush(ObjPersistentVector *vector, Value value);
+
+// vector without its last value, count must be above 0
+ObjPersistentVector *persistentVectorPop(ObjPersistentVector *vector);
+
+// mutable copy for a batch of updates, O(1), shares every node
+Obj *transientOf(Obj *collection);
+
+// end a transient's updates and return them as a persistent
+// collection, the transient can't be used afterwards
+Obj *persistentOf(Obj *transient);
+
+// whether a collection is a transient that was made persistent
+bool isSpentTransient(Obj *collection);
+
+// print {key: value, ...} or [value, ...]
+void printPersistentMap(ObjPersistentMap *map);
+void printPersistentVector(ObjPersistentVector *vector);
+
+#endif
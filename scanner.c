@@ -2,13 +2,22 @@
 #include <string.h>
 
 #include "common.h"
+#include "number.h"
 #include "scanner.h"
 
+// how many ${ } can be open inside each other
+#define MAX_INTERPOLATION_NESTING 8
+
 typedef struct
 {
     const char *start;
     const char *current;
     int line;
+
+    // open braces inside each ${ } being scanned, the
+    // string resumes at the } that closes the interpolation
+    int braces[MAX_INTERPOLATION_NESTING];
+    int interpolationDepth;
 } Scanner;
 
 Scanner scanner;
@@ -19,6 +28,7 @@ void initScanner(const char *source)
     scanner.start = source;
     scanner.current = source;
     scanner.line = 1;
+    scanner.interpolationDepth = 0;
 }
 
 // could be a number
@@ -206,11 +216,23 @@ static Token identifier()
     return makeToken(identifierType());
 }
 
-// string literals
+// string literals, a ${ ends the token as an interpolation
+// and the string picks up again after the matching }
 static Token string()
 {
     while (peek() != '"' && !isAtEnd())
     {
+        if (peek() == '$' && peekNext() == '{')
+        {
+            if (scanner.interpolationDepth == MAX_INTERPOLATION_NESTING)
+                return errorToken("Interpolation is nested too deeply.");
+
+            advance();
+            advance();
+            scanner.braces[scanner.interpolationDepth++] = 0;
+            return makeToken(TOKEN_INTERPOLATION);
+        }
+
         if (peek() == '\n')
         {
             scanner.line++;
@@ -227,27 +249,60 @@ static Token string()
     return makeToken(TOKEN_STRING);
 }
 
-// number literals
-// todo: make sure numbers are properly converted
-static Token number()
+// 0 through 9, no separators
+static bool isDecimal(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// run of digits, an _ separator has to sit between two digits
+static bool digits()
 {
-    // consume all possible digits
     while (isDigit(peek()))
     {
+        if (peek() == '_' && !isDecimal(peekNext()))
+            return false;
+
         advance();
     }
 
+    return true;
+}
+
+// number literals, the value is parsed here so the compiler
+// doesn't have to go over the digits again
+static Token number()
+{
+    // consume all possible digits
+    if (!digits())
+        return errorToken("Digit separators must go between digits.");
+
     // consume if there are two decimals points
-    if (peek() == '.' && isDigit(peekNext()))
+    if (peek() == '.' && isDecimal(peekNext()))
     {
         advance();
 
-        while (isDigit(peek()))
+        if (!digits())
+            return errorToken("Digit separators must go between digits.");
+    }
+
+    // exponent, 1e9 or 2.5e-3
+    char sign = peekNext();
+    if ((peek() == 'e' || peek() == 'E') &&
+        (isDecimal(sign) || ((sign == '+' || sign == '-') && isDecimal(scanner.current[2]))))
+    {
+        advance();
+        if (peek() == '+' || peek() == '-')
             advance();
+
+        if (!digits())
+            return errorToken("Digit separators must go between digits.");
     }
 
     // return number token
-    return makeToken(TOKEN_NUMBER);
+    Token token = makeToken(TOKEN_NUMBER);
+    token.number = parseNumber(token.start, token.length);
+    return token;
 }
 
 // check if current symbol equals symbol param
@@ -294,14 +349,35 @@ Token scanToken()
     case ')':
         return makeToken(TOKEN_RIGHT_PAREN);
     case '{':
+        if (scanner.interpolationDepth > 0)
+            scanner.braces[scanner.interpolationDepth - 1]++;
+
         return makeToken(TOKEN_LEFT_BRACE);
     case '}':
+        if (scanner.interpolationDepth > 0)
+        {
+            // closes the interpolation, back to the string
+            if (scanner.braces[scanner.interpolationDepth - 1] == 0)
+            {
+                scanner.interpolationDepth--;
+                return string();
+            }
+
+            scanner.braces[scanner.interpolationDepth - 1]--;
+        }
+
         return makeToken(TOKEN_RIGHT_BRACE);
+    case '[':
+        return makeToken(TOKEN_LEFT_BRACKET);
+    case ']':
+        return makeToken(TOKEN_RIGHT_BRACKET);
     case ';':
         // todo: remove
         return makeToken(TOKEN_SEMICOLON);
     case ',':
         return makeToken(TOKEN_COMMA);
+    case ':':
+        return makeToken(TOKEN_COLON);
     case '.':
         return makeToken(TOKEN_DOT);
     case '-':
@@ -7,7 +7,10 @@ typedef enum
     TOKEN_RIGHT_PAREN,
     TOKEN_LEFT_BRACE,
     TOKEN_RIGHT_BRACE,
+    TOKEN_LEFT_BRACKET,
+    TOKEN_RIGHT_BRACKET,
     TOKEN_COMMA,
+    TOKEN_COLON,
     TOKEN_DOT,
     TOKEN_MINUS,
     TOKEN_PLUS,
@@ -25,6 +28,7 @@ typedef enum
     TOKEN_LESS_EQUAL,
     TOKEN_IDENTIFIER,
     TOKEN_STRING,
+    TOKEN_INTERPOLATION,
     TOKEN_NUMBER,
     TOKEN_AND,
     TOKEN_CLASS,
@@ -52,6 +56,9 @@ typedef struct
     const char *start;
     int length;
     int line;
+
+    // value of a number literal
+    double number;
 } Token;
 
 void initScanner(const char *source);
@@ -1,199 +1,881 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "memory.h"
 #include "object.h"
 #include "table.h"
 #include "value.h"
 
-// grow when is array 75% full
-#define TABLE_MAX_LOAD 0.75
+// grow the intern set when it is 75% full
+#define INTERN_MAX_LOAD 0.75
+
+// slots probed together, one sse2 register of control bytes
+#define TABLE_GROUP_SIZE 16
+
+// entry arrays grow by half, they are reallocated
+// on their own so don't need to double like the index
+#define GROW_ENTRIES(count) ((count) < 4 ? 4 : (count) + (count) / 2)
+
+// control bytes, a full slot holds the low 7 bits of its key's hash
+// instead so most mismatches are ruled out without loading the key
+#define CONTROL_EMPTY ((int8_t)-128)
+#define CONTROL_DELETED ((int8_t)-2)
+
+// the rest of the hash picks the group probing starts at
+#define HASH_GROUP(hash) ((hash) >> 7)
+#define HASH_FRAGMENT(hash) ((int8_t)((hash) & 0x7F))
+
+// bit i set where control byte i of the group equals byte
+static inline uint32_t groupMatch(const int8_t *group, int8_t byte)
+{
+#ifdef __SSE2__
+    __m128i control = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8(byte)));
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < TABLE_GROUP_SIZE; i++)
+    {
+        if (group[i] == byte)
+            bits |= 1u << i;
+    }
+    return bits;
+#endif
+}
+
+// bit i set where slot i of the group is empty or deleted,
+// both have the sign bit set and full slots never do
+static inline uint32_t groupMatchFree(const int8_t *group)
+{
+#ifdef __SSE2__
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < TABLE_GROUP_SIZE; i++)
+    {
+        if (group[i] < 0)
+            bits |= 1u << i;
+    }
+    return bits;
+#endif
+}
+
+// bytes per index slot, positions use the smallest width that holds
+// every entry so small tables spend 2 bytes of index per slot
+static inline int slotWidth(int capacity)
+{
+    if (capacity <= 256)
+        return 1;
+    if (capacity <= 65536)
+        return 2;
+    return 4;
+}
+
+// position of the entry an index slot points to
+static inline int getSlot(const void *slots, int capacity, int slot)
+{
+    if (capacity <= 256)
+        return ((const uint8_t *)slots)[slot];
+    if (capacity <= 65536)
+        return ((const uint16_t *)slots)[slot];
+    return ((const int32_t *)slots)[slot];
+}
+
+static inline void setSlot(void *slots, int capacity, int slot, int entry)
+{
+    if (capacity <= 256)
+        ((uint8_t *)slots)[slot] = (uint8_t)entry;
+    else if (capacity <= 65536)
+        ((uint16_t *)slots)[slot] = (uint16_t)entry;
+    else
+        ((int32_t *)slots)[slot] = entry;
+}
 
 // constructor for new empty hash table
 void initTable(Table *table)
 {
     table->count = 0;
+    table->used = 0;
+    table->entryCapacity = 0;
     table->capacity = 0;
-    table->entries = NULL;
+    table->control = NULL;
+    table->slots = NULL;
+    table->hashes = NULL;
+    table->keys = NULL;
+    table->values = NULL;
+}
+
+// return the index and entry arrays
+static void freeArrays(Table *table)
+{
+    int entries = table->entryCapacity;
+
+    FREE_ARRAY(int8_t, table->control, table->capacity);
+    FREE_ARRAY(uint8_t, table->slots, table->capacity * slotWidth(table->capacity));
+    FREE_ARRAY(uint32_t, table->hashes, table->capacity == 0 ? 0 : entries);
+    FREE_ARRAY(Value, table->keys, entries);
+    FREE_ARRAY(Value, table->values, entries);
 }
 
 // deallocate items
 void freeTable(Table *table)
 {
-    FREE_ARRAY(Entry, table->entries, table->capacity);
+    freeArrays(table);
     initTable(table);
 }
 
-// return a location for the key
-static Entry *findEntry(Entry *entries, int capacity, ObjString *key)
+// first empty or deleted slot on the hash's probe sequence,
+// groups are visited in triangular steps so every one is reached
+static int findFreeSlot(int8_t *control, int capacity, uint32_t hash)
 {
-    uint32_t index = key->hash % capacity;
-    Entry *tombstone = NULL;
+    uint32_t groupMask = (uint32_t)capacity / TABLE_GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(hash) & groupMask;
 
-    for (;;)
+    for (uint32_t step = 1;; step++)
     {
-        // todo: can we use pointer arithemetic?
-        Entry *entry = &entries[index];
-
-        // todo: refactor
-        if (entry->key == NULL)
-        {
-            if (IS_NIL(entry->value))
-            {
-                return tombstone != NULL ? tombstone : entry;
-            }
-            else
-            {
-                if (tombstone == NULL)
-                {
-                    tombstone = entry;
-                }
-            }
-        }
-        // todo: fix string comparison
-        else if (entry->key == key)
-        {
-            return entry;
-        }
+        uint32_t free = groupMatchFree(control + group * TABLE_GROUP_SIZE);
+        if (free != 0)
+            return (int)(group * TABLE_GROUP_SIZE + __builtin_ctz(free));
 
-        index = (index + 1) % capacity;
+        group = (group + step) & groupMask;
     }
 }
 
-// grows the table
-static void adjustCapacity(Table *table, int capacity)
+// keys are identical, texts are interned and -0 is stored as 0 so
+// this is equality; numbers compare bits so nan can be found again
+static inline bool keysEqual(Value a, Value b)
 {
-    // make new space
-    Entry *entries = ALLOCATE(Entry, capacity);
+    if (a.type != b.type)
+        return false;
 
-    // init items
-    for (int i = 0; i < capacity; i++)
+    switch (a.type)
+    {
+    case VAL_BOOL:
+        return AS_BOOL(a) == AS_BOOL(b);
+    case VAL_NIL:
+        return true;
+    case VAL_NUMBER:
     {
-        entries[i].key = NULL;
-        entries[i].value = NIL_VAL;
+        uint64_t x, y;
+        double numberA = AS_NUMBER(a), numberB = AS_NUMBER(b);
+        memcpy(&x, &numberA, sizeof(x));
+        memcpy(&y, &numberB, sizeof(y));
+        return x == y;
+    }
+    case VAL_OBJ:
+        return AS_OBJ(a) == AS_OBJ(b);
     }
 
-    // copy every existing item
-    table->count = 0;
-    for (int i = 0; i < table->capacity; i++)
+    return false;
+}
+
+// entry of the key in a small table, -1 if it isn't there
+static int findSmallEntry(Table *table, Value key)
+{
+    for (int i = 0; i < table->used; i++)
     {
-        Entry *entry = &table->entries[i];
+        if (keysEqual(table->keys[i], key))
+            return i;
+    }
 
-        if (entry->key == NULL)
+    return -1;
+}
+
+// index slot of the key, -1 if it isn't in the table; only slots whose
+// control byte matches the hash fragment look up their entry's key
+static int findSlot(Table *table, Value key, uint32_t hash)
+{
+    uint32_t groupMask = (uint32_t)table->capacity / TABLE_GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(hash) & groupMask;
+    int8_t fragment = HASH_FRAGMENT(hash);
+    int width = slotWidth(table->capacity);
+
+    for (uint32_t step = 1;; step++)
+    {
+        const int8_t *control = table->control + group * TABLE_GROUP_SIZE;
+
+        // the group's positions don't depend on its control bytes,
+        // fetch both at once instead of one miss after the other
+        __builtin_prefetch((const char *)table->slots + group * TABLE_GROUP_SIZE * width);
+
+        for (uint32_t matches = groupMatch(control, fragment); matches != 0; matches &= matches - 1)
         {
-            continue;
+            int slot = (int)(group * TABLE_GROUP_SIZE + __builtin_ctz(matches));
+            int entry = getSlot(table->slots, table->capacity, slot);
+
+            // a matching fragment is nearly always the key, so its
+            // value is fetched alongside it
+            __builtin_prefetch(&table->values[entry]);
+            if (keysEqual(table->keys[entry], key))
+                return slot;
         }
 
-        Entry *dest = findEntry(entries, capacity, entry->key);
-        dest->key = entry->key;
-        dest->value = entry->value;
+        // a group with an empty slot ends every probe that reaches it
+        if (groupMatch(control, CONTROL_EMPTY) != 0)
+            return -1;
 
-        table->count++;
+        group = (group + step) & groupMask;
     }
+}
+
+// rebuild with a new capacity, live entries are packed to the front
+// in their original order and indexed again from their cached hashes
+static void adjustCapacity(Table *table, int capacity)
+{
+    // make new space, the entry arrays start with room for a
+    // few more keys and grow on their own up to the index's limit
+    int entries = GROW_ENTRIES(table->count);
+    if (entries > TABLE_ENTRIES(capacity))
+        entries = TABLE_ENTRIES(capacity);
+
+    int8_t *control = ALLOCATE(int8_t, capacity);
+    void *slots = ALLOCATE(uint8_t, capacity * slotWidth(capacity));
+    uint32_t *hashes = ALLOCATE(uint32_t, entries);
+    Value *keys = ALLOCATE(Value, entries);
+    Value *values = ALLOCATE(Value, entries);
+    memset(control, CONTROL_EMPTY, capacity);
+
+    // copy every live entry, deleted ones are dropped; a small
+    // table getting its index has no hashes yet
+    int count = 0;
+    for (int i = 0; i < table->used; i++)
+    {
+        if (IS_HOLE(table->keys[i]))
+            continue;
 
-    FREE_ARRAY(Entry, table->entries, table->capacity);
+        uint32_t hash = table->capacity == 0 ? tableKeyHash(table->keys[i]) : table->hashes[i];
+        int slot = findFreeSlot(control, capacity, hash);
+        control[slot] = HASH_FRAGMENT(hash);
+        setSlot(slots, capacity, slot, count);
+
+        hashes[count] = hash;
+        keys[count] = table->keys[i];
+        values[count] = table->values[i];
+        count++;
+    }
 
-    table->entries = entries;
+    freeArrays(table);
+
+    table->control = control;
+    table->slots = slots;
+    table->hashes = hashes;
+    table->keys = keys;
+    table->values = values;
     table->capacity = capacity;
+    table->entryCapacity = entries;
+    table->used = count;
+}
+
+// pack live entries to the front and index them again, clearing
+// every hole and tombstone without allocating
+static void compactTable(Table *table)
+{
+    int count = 0;
+    for (int i = 0; i < table->used; i++)
+    {
+        if (IS_HOLE(table->keys[i]))
+            continue;
+
+        table->hashes[count] = table->hashes[i];
+        table->keys[count] = table->keys[i];
+        table->values[count] = table->values[i];
+        count++;
+    }
+    table->used = count;
+
+    memset(table->control, CONTROL_EMPTY, table->capacity);
+    for (int i = 0; i < count; i++)
+    {
+        int slot = findFreeSlot(table->control, table->capacity, table->hashes[i]);
+        table->control[slot] = HASH_FRAGMENT(table->hashes[i]);
+        setSlot(table->slots, table->capacity, slot, i);
+    }
+}
+
+// more room in the entry arrays without touching the index
+static void growEntries(Table *table)
+{
+    int oldEntries = table->entryCapacity;
+    int limit = table->capacity == 0 ? TABLE_SMALL_ENTRIES : TABLE_ENTRIES(table->capacity);
+    int entries = GROW_ENTRIES(oldEntries);
+    if (entries > limit)
+        entries = limit;
+
+    // allocate everything before touching the table, running out of
+    // memory part way must leave its arrays matching entryCapacity
+    uint32_t *hashes = table->capacity == 0 ? NULL : ALLOCATE(uint32_t, entries);
+    Value *keys = ALLOCATE(Value, entries);
+    Value *values = ALLOCATE(Value, entries);
+
+    if (oldEntries != 0)
+    {
+        if (hashes != NULL)
+            memcpy(hashes, table->hashes, sizeof(uint32_t) * table->used);
+        memcpy(keys, table->keys, sizeof(Value) * table->used);
+        memcpy(values, table->values, sizeof(Value) * table->used);
+
+        if (table->capacity != 0)
+            FREE_ARRAY(uint32_t, table->hashes, oldEntries);
+        FREE_ARRAY(Value, table->keys, oldEntries);
+        FREE_ARRAY(Value, table->values, oldEntries);
+    }
+
+    table->hashes = hashes;
+    table->keys = keys;
+    table->values = values;
+    table->entryCapacity = entries;
 }
 
 // return if item exists, set value pointer to this value
-bool tableGet(Table *table, ObjString *key, Value *value)
+static bool getEntry(Table *table, Value key, uint32_t hash, Value *value)
 {
     // empty table
     if (table->count == 0)
         return false;
 
-    Entry *entry = findEntry(table->entries, table->capacity, key);
+    if (table->capacity == 0)
+    {
+        int entry = findSmallEntry(table, key);
+        if (entry < 0)
+            return false;
+
+        *value = table->values[entry];
+        return true;
+    }
+
+    int slot = findSlot(table, key, hash);
 
     // item not found
-    if (entry->key == NULL)
+    if (slot < 0)
         return false;
 
     // set and return entry
-    *value = entry->value;
+    *value = table->values[getSlot(table->slots, table->capacity, slot)];
     return true;
 }
 
-// returns true if value already exists, always caches the value
-bool tableSet(Table *table, ObjString *key, Value value)
+// returns true if the key is new, always caches the value
+static bool setEntry(Table *table, Value key, uint32_t hash, Value value)
 {
-    if (table->count + 1 > table->capacity * TABLE_MAX_LOAD)
+    if (table->count > 0 && table->capacity == 0)
+    {
+        int entry = findSmallEntry(table, key);
+        if (entry >= 0)
+        {
+            table->values[entry] = value;
+            return false;
+        }
+    }
+    else if (table->count > 0)
     {
-        adjustCapacity(table, GROW_CAPACITY(table->capacity));
+        int slot = findSlot(table, key, hash);
+        if (slot >= 0)
+        {
+            table->values[getSlot(table->slots, table->capacity, slot)] = value;
+            return false;
+        }
     }
 
-    Entry *entry = findEntry(table->entries, table->capacity, key);
-
-    bool isNewKey = entry->key == NULL;
-    if (isNewKey && IS_NIL(entry->value))
+    // small tables only append until they are too big to scan
+    if (table->capacity == 0 && table->used < TABLE_SMALL_ENTRIES)
     {
+        if (table->used + 1 > table->entryCapacity)
+            growEntries(table);
+
+        int entry = table->used++;
+        table->keys[entry] = key;
+        table->values[entry] = value;
         table->count++;
+        return true;
     }
 
-    entry->key = key;
-    entry->value = value;
+    // new keys are appended, once the entry arrays reach the index's
+    // limit rebuild, only growing when holes from deletes wouldn't
+    // free up enough room
+    if (table->used + 1 > table->entryCapacity && table->used < TABLE_ENTRIES(table->capacity))
+    {
+        growEntries(table);
+    }
+    else if (table->used + 1 > table->entryCapacity)
+    {
+        int capacity = table->capacity;
+        if (capacity < TABLE_GROUP_SIZE)
+            capacity = TABLE_GROUP_SIZE;
+        else if (table->count + 1 > TABLE_ENTRIES(capacity) / 2)
+            capacity *= 2;
+
+        adjustCapacity(table, capacity);
+    }
+
+    int slot = findFreeSlot(table->control, table->capacity, hash);
+    int entry = table->used++;
 
-    return isNewKey;
+    table->control[slot] = HASH_FRAGMENT(hash);
+    setSlot(table->slots, table->capacity, slot, entry);
+    table->hashes[entry] = hash;
+    table->keys[entry] = key;
+    table->values[entry] = value;
+    table->count++;
+
+    return true;
 }
 
-// use tombstoning to override items
-bool tableDelete(Table *table, ObjString *key)
+// remove an item, its entry stays as a hole until the table is rebuilt
+// and its slot only becomes a tombstone if probes for other keys may
+// have passed through its group
+static int deleteEntry(Table *table, Value key, uint32_t hash)
 {
     if (table->count == 0)
-        return false;
+        return -1;
+
+    if (table->capacity == 0)
+    {
+        int entry = findSmallEntry(table, key);
+        if (entry < 0)
+            return -1;
+
+        // close the gap, small tables never hold holes
+        int after = table->used - entry - 1;
+        memmove(table->keys + entry, table->keys + entry + 1, sizeof(Value) * after);
+        memmove(table->values + entry, table->values + entry + 1, sizeof(Value) * after);
+        table->used--;
+        table->count--;
+        return entry;
+    }
+
+    int slot = findSlot(table, key, hash);
+
+    if (slot < 0)
+        return -1;
+
+    const int8_t *group = table->control + (slot & ~(TABLE_GROUP_SIZE - 1));
+    table->control[slot] = groupMatch(group, CONTROL_EMPTY) != 0 ? CONTROL_EMPTY : CONTROL_DELETED;
+
+    int entry = getSlot(table->slots, table->capacity, slot);
+    table->keys[entry] = HOLE_VAL;
+    table->values[entry] = NIL_VAL;
+    table->count--;
+
+    if (table->capacity > TABLE_GROUP_SIZE && table->count < TABLE_ENTRIES(table->capacity) / 4)
+    {
+        // mostly empty, give memory back; the smaller table is
+        // left half full so it won't shrink again right away
+        int capacity = table->capacity;
+        while (capacity > TABLE_GROUP_SIZE && table->count <= TABLE_ENTRIES(capacity / 2) / 2)
+            capacity /= 2;
+
+        adjustCapacity(table, capacity);
+    }
+    else if (table->used - table->count > TABLE_ENTRIES(table->capacity) / 4)
+    {
+        // holes make up a quarter of the table, clear them out
+        // before they make probes and the next rebuild longer
+        compactTable(table);
+    }
+
+    return entry;
+}
+
+bool tableGet(Table *table, ObjString *key, Value *value)
+{
+    return getEntry(table, OBJ_VAL(key), key->hash, value);
+}
 
-    Entry *entry = findEntry(table->entries, table->capacity, key);
+bool tableSet(Table *table, ObjString *key, Value value)
+{
+    return setEntry(table, OBJ_VAL(key), key->hash, value);
+}
 
-    if (entry->key == NULL)
+bool tableDelete(Table *table, ObjString *key)
+{
+    return deleteEntry(table, OBJ_VAL(key), key->hash) >= 0;
+}
+
+// the same key for values that are equal: texts become interned
+// strings, -0 becomes 0
+Value tableKey(Value key)
+{
+    if (isText(key))
+        return OBJ_VAL(internString(textString(AS_OBJ(key))));
+
+    if (IS_NUMBER(key) && AS_NUMBER(key) == 0)
+        return NUMBER_VAL(0);
+
+    return key;
+}
+
+// spread the bits of a 64 bit key over the hash
+static uint32_t hashBits(uint64_t bits)
+{
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    bits *= 0xc4ceb9fe1a85ec53ull;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+// hash of a normalized key, strings keep their own hash and
+// other objects hash by identity
+uint32_t tableKeyHash(Value key)
+{
+    switch (key.type)
+    {
+    case VAL_BOOL:
+        return AS_BOOL(key) ? 1 : 2;
+    case VAL_NIL:
+        return 3;
+    case VAL_NUMBER:
+    {
+        uint64_t bits;
+        double number = AS_NUMBER(key);
+        memcpy(&bits, &number, sizeof(bits));
+        return hashBits(bits);
+    }
+    case VAL_OBJ:
+        if (IS_STRING(key))
+            return stringHash(AS_STRING(key));
+
+        return hashBits((uint64_t)(uintptr_t)AS_OBJ(key));
+    }
+
+    return 0;
+}
+
+bool tableKeysEqual(Value a, Value b)
+{
+    return keysEqual(a, b);
+}
+
+bool tableGetValue(Table *table, Value key, Value *value)
+{
+    key = tableKey(key);
+    return getEntry(table, key, tableKeyHash(key), value);
+}
+
+bool tableSetValue(Table *table, Value key, Value value)
+{
+    key = tableKey(key);
+    return setEntry(table, key, tableKeyHash(key), value);
+}
+
+bool tableDeleteValue(Table *table, Value key)
+{
+    key = tableKey(key);
+    return deleteEntry(table, key, tableKeyHash(key)) >= 0;
+}
+
+// steps from the cursor to the entry, so a walk in order passes
+// each hole once; the table itself is only read
+int tableSeek(Table *table, TableCursor *cursor, int position)
+{
+    // no holes, positions are entries
+    if (table->used == table->count)
+    {
+        cursor->entry = position;
+        cursor->position = position;
+        return position;
+    }
+
+    int entry = cursor->entry;
+    int at = cursor->position;
+
+    // nearer the start than the cursor
+    if (position < at - position)
+    {
+        entry = 0;
+        at = 0;
+    }
+
+    while (at > position)
+    {
+        entry--;
+        if (!IS_HOLE(table->keys[entry]))
+            at--;
+    }
+
+    while (at < position || IS_HOLE(table->keys[entry]))
+    {
+        if (!IS_HOLE(table->keys[entry]))
+            at++;
+        entry++;
+    }
+
+    cursor->entry = entry;
+    cursor->position = at;
+    return entry;
+}
+
+bool tableDeleteFrom(Table *table, TableCursor *cursor, Value key)
+{
+    // a rebuild since the cursor was last moved left no holes,
+    // the live entries before it are now the first ones
+    if (table->used == table->count)
+        cursor->entry = cursor->position;
+
+    key = tableKey(key);
+    int entry = deleteEntry(table, key, tableKeyHash(key));
+    if (entry < 0)
         return false;
 
-    // mark value as skippable
-    entry->key = NULL;
-    entry->value = BOOL_VAL(true);
+    if (entry < cursor->entry)
+        cursor->position--;
+
+    // closed up or rebuilt, either way there are no holes now
+    if (table->used == table->count)
+        cursor->entry = cursor->position;
 
     return true;
 }
 
-// copies table values
+// copies table values in insertion order, an empty table
+// with no holes in an indexed source is copied wholesale
 void tableAddAll(Table *from, Table *to)
 {
-    for (int i = 0; i < from->capacity; i++)
+    if (to->count == 0 && from->capacity != 0 && from->count == from->used)
     {
-        Entry *entry = &from->entries[i];
+        int entries = from->entryCapacity;
+        int slotBytes = from->capacity * slotWidth(from->capacity);
+
+        int8_t *control = ALLOCATE(int8_t, from->capacity);
+        void *slots = ALLOCATE(uint8_t, slotBytes);
+        uint32_t *hashes = ALLOCATE(uint32_t, entries);
+        Value *keys = ALLOCATE(Value, entries);
+        Value *values = ALLOCATE(Value, entries);
+
+        freeArrays(to);
+        to->control = control;
+        to->slots = slots;
+        to->hashes = hashes;
+        to->keys = keys;
+        to->values = values;
+        to->capacity = from->capacity;
+        to->entryCapacity = entries;
+        to->count = from->count;
+        to->used = from->used;
+
+        memcpy(to->control, from->control, from->capacity);
+        memcpy(to->slots, from->slots, slotBytes);
+        memcpy(to->hashes, from->hashes, sizeof(uint32_t) * from->used);
+        memcpy(to->keys, from->keys, sizeof(Value) * from->used);
+        memcpy(to->values, from->values, sizeof(Value) * from->used);
+        return;
+    }
 
-        if (entry->key != NULL)
-        {
-            tableSet(to, entry->key, entry->value);
-        }
+    for (int i = 0; i < from->used; i++)
+    {
+        if (IS_HOLE(from->keys[i]))
+            continue;
+
+        uint32_t hash = from->capacity == 0 ? tableKeyHash(from->keys[i]) : from->hashes[i];
+        setEntry(to, from->keys[i], hash, from->values[i]);
+    }
+}
+
+// groups a lookup for the key in slot visits
+static int probeLength(Table *table, int slot, uint32_t hash)
+{
+    uint32_t groupMask = (uint32_t)table->capacity / TABLE_GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(hash) & groupMask;
+    uint32_t target = (uint32_t)slot / TABLE_GROUP_SIZE;
+
+    int length = 1;
+    for (uint32_t step = 1; group != target; step++)
+    {
+        group = (group + step) & groupMask;
+        length++;
+    }
+
+    return length;
+}
+
+// walk every key and measure how far lookups for it probe
+TableStats tableStats(Table *table)
+{
+    TableStats stats;
+    stats.count = table->count;
+    stats.capacity = table->capacity;
+    stats.holes = table->used - table->count;
+    stats.tombstones = 0;
+    stats.maxProbe = 0;
+    stats.averageProbe = 0;
+
+    long total = 0;
+    for (int i = 0; i < table->capacity; i++)
+    {
+        if (table->control[i] == CONTROL_DELETED)
+            stats.tombstones++;
+
+        if (table->control[i] < 0)
+            continue;
+
+        int entry = getSlot(table->slots, table->capacity, i);
+        int length = probeLength(table, i, table->hashes[entry]);
+
+        total += length;
+        if (length > stats.maxProbe)
+            stats.maxProbe = length;
     }
+
+    if (table->count > 0)
+        stats.averageProbe = (double)total / table->count;
+
+    return stats;
 }
 
-// look for string in table
+// look for string in table, the full cached hash is compared
+// before a candidate key is loaded
 ObjString *tableFindString(Table *table, const char *chars, int length, uint32_t hash)
 {
     if (table->count == 0)
         return NULL;
 
-    uint32_t index = hash % table->capacity;
+    if (table->capacity == 0)
+    {
+        for (int i = 0; i < table->used; i++)
+        {
+            if (!IS_STRING(table->keys[i]))
+                continue;
+
+            ObjString *key = AS_STRING(table->keys[i]);
+            if (key->length == length && charsEqual(key->chars, chars, length))
+                return key;
+        }
+
+        return NULL;
+    }
+
+    uint32_t groupMask = (uint32_t)table->capacity / TABLE_GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(hash) & groupMask;
+    int8_t fragment = HASH_FRAGMENT(hash);
+
+    for (uint32_t step = 1;; step++)
+    {
+        const int8_t *control = table->control + group * TABLE_GROUP_SIZE;
+
+        for (uint32_t matches = groupMatch(control, fragment); matches != 0; matches &= matches - 1)
+        {
+            int entry = getSlot(table->slots, table->capacity, group * TABLE_GROUP_SIZE + __builtin_ctz(matches));
+            if (table->hashes[entry] != hash)
+                continue;
+
+            ObjString *key = AS_STRING(table->keys[entry]);
+            if (key->length == length && charsEqual(key->chars, chars, length))
+            {
+                // found string
+                return key;
+            }
+        }
+
+        if (groupMatch(control, CONTROL_EMPTY) != 0)
+            return NULL;
+
+        group = (group + step) & groupMask;
+    }
+}
+
+// keys followed by their hashes in a single block
+#define INTERN_SET_BYTES(capacity) ((size_t)(capacity) * (sizeof(ObjString *) + sizeof(uint32_t)))
+
+// constructor for an empty intern set
+void initInternSet(InternSet *set)
+{
+    set->count = 0;
+    set->capacity = 0;
+    set->keys = NULL;
+    set->hashes = NULL;
+}
+
+// deallocate slots, the strings belong to the heap
+void freeInternSet(InternSet *set)
+{
+    reallocate(set->keys, INTERN_SET_BYTES(set->capacity), 0);
+    initInternSet(set);
+}
+
+// move keys into a new pair of arrays, both come from one allocation
+// so running out of memory can't leave one of them behind
+static void internSetResize(InternSet *set, int capacity)
+{
+    ObjString **keys = (ObjString **)reallocate(NULL, 0, INTERN_SET_BYTES(capacity));
+    uint32_t *hashes = (uint32_t *)(keys + capacity);
+
+    for (int i = 0; i < capacity; i++)
+        keys[i] = NULL;
+
+    uint32_t mask = capacity - 1;
+    for (int i = 0; i < set->capacity; i++)
+    {
+        ObjString *key = set->keys[i];
+        if (key == NULL)
+            continue;
+
+        uint32_t index = set->hashes[i] & mask;
+        while (keys[index] != NULL)
+            index = (index + 1) & mask;
+
+        keys[index] = key;
+        hashes[index] = set->hashes[i];
+    }
+
+    reallocate(set->keys, INTERN_SET_BYTES(set->capacity), 0);
+
+    set->keys = keys;
+    set->hashes = hashes;
+    set->capacity = capacity;
+}
+
+// look for string in the set
+ObjString *internSetFind(InternSet *set, const char *chars, int length, uint32_t hash)
+{
+    if (set->count == 0)
+        return NULL;
+
+    uint32_t mask = set->capacity - 1;
+    uint32_t index = hash & mask;
 
     for (;;)
     {
-        Entry *entry = &table->entries[index];
+        ObjString *key = set->keys[index];
 
-        // todo: refactor
-        if (entry->key == NULL)
+        if (key == NULL)
+            return NULL;
+
+        // the cached hash rules out most keys without loading them
+        if (set->hashes[index] == hash && key->length == length &&
+            charsEqual(key->chars, chars, length))
         {
-            // tombstone
-            if (IS_NIL(entry->value))
-                return NULL;
+            return key;
         }
-        else if (entry->key->length == length && entry->key->hash == hash && memcmp(entry->key->chars, chars, length) == 0)
+
+        index = (index + 1) & mask;
+    }
+}
+
+// add a string not already in the set
+void internSetAdd(InternSet *set, ObjString *string)
+{
+    if (set->count + 1 > set->capacity * INTERN_MAX_LOAD)
+        internSetResize(set, GROW_CAPACITY(set->capacity));
+
+    uint32_t mask = set->capacity - 1;
+    uint32_t index = string->hash & mask;
+
+    for (;;)
+    {
+        ObjString *key = set->keys[index];
+
+        if (key == NULL)
         {
-            // found string
-            return entry->key;
+            set->keys[index] = string;
+            set->hashes[index] = string->hash;
+            set->count++;
+            return;
         }
 
-        index = (index + 1) % table->capacity;
+        index = (index + 1) & mask;
     }
-}
\ No newline at end of file
+}
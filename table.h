@@ -4,24 +4,93 @@
 #include "common.h"
 #include "value.h"
 
-typedef struct
-{
-    ObjString *key;
-    Value value;
-} Entry;
+// key of a deleted entry, never a real key
+#define HOLE_VAL ((Value){VAL_OBJ, {.obj = NULL}})
+#define IS_HOLE(value) ((value).type == VAL_OBJ && (value).as.obj == NULL)
+
+// entries a table with this many index slots holds, its load factor;
+// probing a group at a time keeps chains short even 7/8 full
+#define TABLE_ENTRIES(capacity) ((capacity) / 8 * 7)
 
+// tables this small have no index, their keys are scanned in
+// order, which is as quick as a probe and saves the index's bytes
+#define TABLE_SMALL_ENTRIES 12
+
+// compact table: a swiss table index of small slots points into dense
+// entry arrays kept in insertion order. a control byte per slot is
+// probed 16 at a time and only slots whose byte matches the key's
+// hash look at their entry, hashes, keys and values are separate
+// arrays so a probe only pulls in the parts it compares
 typedef struct
 {
     // number of key/value pairs
     int count;
 
-    // allocated size, count & capacity = load factor
+    // entries appended so far, deleted ones stay as holes
+    // with a NULL key until the table is rebuilt
+    int used;
+
+    // room in the entry arrays, at most TABLE_ENTRIES(capacity)
+    int entryCapacity;
+
+    // index slots, a power of two of at least one group,
+    // 0 while the table is small and has no index
     int capacity;
 
-    // array of entries
-    Entry *entries;
+    // per slot: empty, deleted, or 7 bits of the key's hash
+    int8_t *control;
+
+    // per slot: position of its entry, 1, 2 or 4 bytes
+    // wide depending on how many entries the table holds
+    void *slots;
+
+    // entries in insertion order, the full hash is compared
+    // before the key is loaded; small tables don't keep hashes
+    uint32_t *hashes;
+    Value *keys;
+    Value *values;
 } Table;
 
+// where a walk over a table's live entries by position last stopped,
+// position is the number of live entries before entry
+typedef struct
+{
+    int entry;
+    int position;
+} TableCursor;
+
+// set of interned strings, keys only with their hashes cached
+// next to them so probing never touches the strings themselves;
+// strings live as long as the vm, so nothing is ever removed
+typedef struct
+{
+    // number of keys
+    int count;
+
+    // allocated size, always a power of two
+    int capacity;
+
+    // parallel arrays of keys and their hashes, one
+    // allocation with the hashes after the keys
+    ObjString **keys;
+    uint32_t *hashes;
+} InternSet;
+
+// shape of a table and how long its probes run, for tuning
+typedef struct
+{
+    int count;
+    int capacity;
+
+    // deleted entries and index slots not cleared yet
+    int holes;
+    int tombstones;
+
+    // groups a lookup visits before finding its key
+    int maxProbe;
+    double averageProbe;
+} TableStats;
+
 // constructor to create a new hash table
 void initTable(Table *table);
 
@@ -31,7 +100,7 @@ void freeTable(Table *table);
 // return if exists, place into value pointer
 bool tableGet(Table *table, ObjString *key, Value *value);
 
-// insert into table
+// insert into table, keys must be interned strings
 bool tableSet(Table *table, ObjString *key, Value value);
 
 // delete items
@@ -40,7 +109,40 @@ bool tableDelete(Table *table, ObjString *key);
 // copy entries over
 void tableAddAll(Table *from, Table *to);
 
+// the same for any value as a key, texts are interned first
+bool tableGetValue(Table *table, Value key, Value *value);
+bool tableSetValue(Table *table, Value key, Value value);
+bool tableDeleteValue(Table *table, Value key);
+
+// how tables see a key: texts become their interned string and -0
+// becomes 0, the hash and equality work on keys made this way
+Value tableKey(Value key);
+uint32_t tableKeyHash(Value key);
+bool tableKeysEqual(Value a, Value b);
+
+// entry of the live key at a position in insertion order, position
+// must be below count; the cursor moves there
+int tableSeek(Table *table, TableCursor *cursor, int position);
+
+// delete a key, keeping the cursor on the same live entries
+bool tableDeleteFrom(Table *table, TableCursor *cursor, Value key);
+
 // finds a string
 ObjString *tableFindString(Table *table, const char *chars, int length, uint32_t hash);
 
+// measure a table's probe lengths, walks every key
+TableStats tableStats(Table *table);
+
+// create an empty intern set
+void initInternSet(InternSet *set);
+
+// return memory
+void freeInternSet(InternSet *set);
+
+// finds an interned string by its contents
+ObjString *internSetFind(InternSet *set, const char *chars, int length, uint32_t hash);
+
+// add a string not already in the set
+void internSetAdd(InternSet *set, ObjString *string);
+
 #endif
\ No newline at end of file
@@ -11,6 +11,7 @@ void initValueArray(ValueArray *array)
     array->values = NULL;
     array->capacity = 0;
     array->count = 0;
+    array->arena = NULL;
 }
 
 // write literal/constant value
@@ -20,21 +21,49 @@ void writeArrayValue(ValueArray *array, Value value)
     if (array->capacity < array->count + 1)
     {
         int oldCapacity = array->capacity;
-        array->capacity = GROW_CAPACITY(oldCapacity);
-        array->values = GROW_ARRAY(Value, array->values, oldCapacity, array->capacity);
+        int capacity = GROW_CAPACITY(oldCapacity);
+
+        if (array->arena != NULL)
+            array->values = GROW_SCRATCH(array->arena, Value, array->values, oldCapacity, capacity);
+        else
+            array->values = GROW_ARRAY(Value, array->values, oldCapacity, capacity);
+
+        // only once the array exists, growing can jump out on oom
+        array->capacity = capacity;
     }
 
     array->values[array->count] = value;
     array->count++;
 }
 
-// free literal array
+// free literal array, arena memory is freed with its arena
 void freeValueArray(ValueArray *array)
 {
-    FREE_ARRAY(Value, array->values, array->capacity);
+    if (array->arena == NULL)
+        FREE_ARRAY(Value, array->values, array->capacity);
+
     initValueArray(array);
 }
 
+// drop the growth slack, moving the values out of an arena
+void shrinkValueArray(ValueArray *array)
+{
+    Value *values = NULL;
+
+    if (array->count > 0)
+    {
+        values = ALLOCATE(Value, array->count);
+        memcpy(values, array->values, sizeof(Value) * array->count);
+    }
+
+    if (array->arena == NULL)
+        FREE_ARRAY(Value, array->values, array->capacity);
+
+    array->values = values;
+    array->capacity = array->count;
+    array->arena = NULL;
+}
+
 // print value
 void printValue(Value value)
 {
@@ -52,7 +81,9 @@ void printValue(Value value)
     }
     case VAL_NUMBER:
     {
-        printf("%g", AS_NUMBER(value));
+        char buffer[NUMBER_BUFFER_SIZE];
+        int length = formatNumber(AS_NUMBER(value), buffer);
+        fwrite(buffer, 1, length, stdout);
         break;
     }
     case VAL_OBJ:
@@ -91,6 +122,10 @@ bool valuesEquate(Value a, Value b)
         // both are numbers
         return AS_NUMBER(a) == AS_NUMBER(b);
     case VAL_OBJ:
+        // strings, ropes and slices compare by content
+        if (isText(a) && isText(b))
+            return textsEqual(AS_OBJ(a), AS_OBJ(b));
+
         return AS_OBJ(a) == AS_OBJ(b);
     default:
         // unreachable
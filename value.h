@@ -2,9 +2,11 @@
 #define blue_value_h
 
 #include "common.h"
+#include "number.h"
 
 typedef struct Obj Obj;
 typedef struct ObjString ObjString;
+typedef struct ScratchArena ScratchArena;
 
 typedef enum
 {
@@ -56,6 +58,9 @@ typedef struct
 
     // array of values
     Value *values;
+
+    // arena the values grow in while compiling, NULL when on the heap
+    ScratchArena *arena;
 } ValueArray;
 
 // returns a C bool for the users code to see
@@ -70,6 +75,9 @@ void writeArrayValue(ValueArray *array, Value value);
 // delete items
 void freeValueArray(ValueArray *array);
 
+// move values into an exactly sized heap array
+void shrinkValueArray(ValueArray *array);
+
 // void print value
 void printValue(Value value);
 
@@ -7,9 +7,11 @@
 #include "common.h"
 #include "compiler.h"
 #include "debug.h"
+#include "kernels.h"
 #include "object.h"
 #include "math.h"
 #include "memory.h"
+#include "persistent.h"
 #include "vm.h"
 
 VM vm;
@@ -24,10 +26,17 @@ static Value clockNative(int argCount, Value *args)
 static Value printFileNative(int argCount, Value *args)
 {
     char buf[1024];
+    char path[1024];
     FILE *file;
     size_t nread;
 
-    file = fopen(AS_CSTRING(args[0]), "r");
+    // texts aren't always null terminated
+    if (isText(args[0]))
+        snprintf(path, sizeof(path), "%.*s", textLength(AS_OBJ(args[0])), textChars(AS_OBJ(args[0])));
+    else
+        path[0] = '\0';
+
+    file = fopen(path, "r");
     if (file)
     {
         // print contnets 'sizeof buffer' bytes at a time
@@ -39,7 +48,7 @@ static Value printFileNative(int argCount, Value *args)
         // deal with error
         if (ferror(file))
         {
-            printf("Error printing: %s", AS_CSTRING(args[0]));
+            printf("Error printing: %s", path);
         }
 
         fclose(file);
@@ -48,13 +57,629 @@ static Value printFileNative(int argCount, Value *args)
     {
         // file does not exist
         fclose(file);
-        printf("Error file does not exist: %s", AS_CSTRING(args[0]));
+        printf("Error file does not exist: %s", path);
         exit(1);
     }
 
     return NUMBER_VAL(100);
 }
 
+// substr(text, start, length): slice of text, shares its chars
+static Value substrNative(int argCount, Value *args)
+{
+    if (argCount != 3 || !isText(args[0]) || !IS_NUMBER(args[1]) || !IS_NUMBER(args[2]))
+        return nativeError("substr expects a string, a start and a length.");
+
+    Obj *text = AS_OBJ(args[0]);
+    double start = AS_NUMBER(args[1]);
+    double length = AS_NUMBER(args[2]);
+
+    // checked as doubles before converting, written so nan fails too
+    if (!(start >= 0 && start <= textLength(text)) || !(length >= 0 && length <= textLength(text) - start))
+        return nativeError("substr range %g..%g is out of bounds.", start, start + length);
+
+    return sliceText(text, (int)start, (int)length);
+}
+
+// position of needle in haystack at or after from, -1 when missing
+static int findText(const char *haystack, int haystackLength, const char *needle, int needleLength, int from)
+{
+    if (needleLength == 0)
+        return from <= haystackLength ? from : -1;
+
+    if (needleLength > haystackLength)
+        return -1;
+
+    const char *end = haystack + haystackLength - needleLength + 1;
+    const char *curr = haystack + from;
+
+    // jump between first character matches
+    while (curr < end)
+    {
+        curr = memchr(curr, needle[0], end - curr);
+        if (curr == NULL)
+            return -1;
+
+        if (memcmp(curr, needle, needleLength) == 0)
+            return (int)(curr - haystack);
+
+        curr++;
+    }
+
+    return -1;
+}
+
+// indexOf(text, needle): first position of needle, -1 when missing
+static Value indexOfNative(int argCount, Value *args)
+{
+    if (argCount != 2 || !isText(args[0]) || !isText(args[1]))
+        return nativeError("indexOf expects two strings.");
+
+    Obj *text = AS_OBJ(args[0]);
+    Obj *needle = AS_OBJ(args[1]);
+
+    int index = findText(textChars(text), textLength(text), textChars(needle), textLength(needle), 0);
+    return NUMBER_VAL(index);
+}
+
+// every field of a text as a list of slices
+static Value splitAll(Obj *text, Obj *separator)
+{
+    const char *chars = textChars(text);
+    int length = textLength(text);
+    const char *sepChars = textChars(separator);
+    int sepLength = textLength(separator);
+
+    if (sepLength == 0)
+        return nativeError("split separator can't be empty.");
+
+    ObjList *fields = newList();
+
+    int start = 0;
+    while (true)
+    {
+        int end = findText(chars, length, sepChars, sepLength, start);
+        Value field = sliceText(text, start, (end == -1 ? length : end) - start);
+        listAppend(fields, &field, 1);
+
+        if (end == -1)
+            break;
+
+        start = end + sepLength;
+    }
+
+    return OBJ_VAL(fields);
+}
+
+// split(text, separator): list of the fields,
+// split(text, separator, index): field at index as a slice, nil past the last
+static Value splitNative(int argCount, Value *args)
+{
+    if (argCount == 2 && isText(args[0]) && isText(args[1]))
+        return splitAll(AS_OBJ(args[0]), AS_OBJ(args[1]));
+
+    if (argCount != 3 || !isText(args[0]) || !isText(args[1]) || !IS_NUMBER(args[2]))
+        return nativeError("split expects a string, a separator and an optional index.");
+
+    Obj *text = AS_OBJ(args[0]);
+    Obj *separator = AS_OBJ(args[1]);
+
+    const char *chars = textChars(text);
+    int length = textLength(text);
+    const char *sepChars = textChars(separator);
+    int sepLength = textLength(separator);
+
+    if (sepLength == 0)
+        return nativeError("split separator can't be empty.");
+
+    // a text has at most length + 1 fields, checked as a double
+    // before converting so nan and huge indexes are just missing
+    double index = AS_NUMBER(args[2]);
+    if (!(index >= 0 && index <= length))
+        return NIL_VAL;
+
+    int field = (int)index;
+
+    // skip to the start of the field
+    int start = 0;
+    for (int i = 0; i < field; i++)
+    {
+        int found = findText(chars, length, sepChars, sepLength, start);
+        if (found == -1)
+            return NIL_VAL;
+
+        start = found + sepLength;
+    }
+
+    int end = findText(chars, length, sepChars, sepLength, start);
+    if (end == -1)
+        end = length;
+
+    return sliceText(text, start, end - start);
+}
+
+// stringBuilder(): empty mutable string buffer
+static Value stringBuilderNative(int argCount, Value *args)
+{
+    if (argCount != 0)
+        return nativeError("stringBuilder takes no arguments.");
+
+    return OBJ_VAL(newStringBuilder());
+}
+
+// append(builder, value): add text, numbers, booleans or nil, returns the builder
+static Value appendNative(int argCount, Value *args)
+{
+    if (argCount != 2 || !IS_STRING_BUILDER(args[0]))
+        return nativeError("append expects a string builder and a value.");
+
+    ObjStringBuilder *builder = AS_STRING_BUILDER(args[0]);
+    Value value = args[1];
+
+    if (isText(value))
+    {
+        builderAppend(builder, textChars(AS_OBJ(value)), textLength(AS_OBJ(value)));
+    }
+    else if (IS_NUMBER(value))
+    {
+        // format straight into the buffer
+        char *dest = builderReserve(builder, NUMBER_BUFFER_SIZE);
+        builder->length += formatNumber(AS_NUMBER(value), dest);
+    }
+    else if (IS_BOOL(value))
+    {
+        builderAppend(builder, AS_BOOL(value) ? "true" : "false", AS_BOOL(value) ? 4 : 5);
+    }
+    else if (IS_NIL(value))
+    {
+        builderAppend(builder, "nil", 3);
+    }
+    else
+    {
+        return nativeError("Only strings, numbers, booleans and nil can be appended.");
+    }
+
+    return args[0];
+}
+
+// length(value): chars in a string or string builder, entries in a collection
+static Value lengthNative(int argCount, Value *args)
+{
+    if (argCount == 1 && isText(args[0]))
+        return NUMBER_VAL(textLength(AS_OBJ(args[0])));
+
+    if (argCount == 1 && IS_STRING_BUILDER(args[0]))
+        return NUMBER_VAL(AS_STRING_BUILDER(args[0])->length);
+
+    if (argCount == 1 && IS_MAP(args[0]))
+        return NUMBER_VAL(AS_MAP(args[0])->table.count);
+
+    if (argCount == 1 && IS_LIST(args[0]))
+        return NUMBER_VAL(AS_LIST(args[0])->items.count);
+
+    if (argCount == 1 && IS_FLOAT64_ARRAY(args[0]))
+        return NUMBER_VAL(AS_FLOAT64_ARRAY(args[0])->count);
+
+    if (argCount == 1 && IS_PERSISTENT_MAP(args[0]))
+        return NUMBER_VAL(AS_PERSISTENT_MAP(args[0])->count);
+
+    if (argCount == 1 && IS_PERSISTENT_VECTOR(args[0]))
+        return NUMBER_VAL(AS_PERSISTENT_VECTOR(args[0])->count);
+
+    return nativeError("length expects a string, string builder or collection.");
+}
+
+// hasKey(map, key): whether the map holds the key
+static Value hasKeyNative(int argCount, Value *args)
+{
+    Value value;
+
+    if (argCount == 2 && IS_MAP(args[0]))
+        return BOOL_VAL(tableGetValue(&AS_MAP(args[0])->table, args[1], &value));
+
+    if (argCount == 2 && IS_PERSISTENT_MAP(args[0]))
+        return BOOL_VAL(persistentMapGet(AS_PERSISTENT_MAP(args[0]), args[1], &value));
+
+    return nativeError("hasKey expects a map and a key.");
+}
+
+// remove(map, key): drop a key, returns whether it was there
+static Value removeNative(int argCount, Value *args)
+{
+    if (argCount != 2 || !IS_MAP(args[0]))
+        return nativeError("remove expects a map and a key.");
+
+    ObjMap *map = AS_MAP(args[0]);
+    return BOOL_VAL(tableDeleteFrom(&map->table, &map->cursor, args[1]));
+}
+
+// entry holding the i'th live key of a map, -1 with an error raised if out of
+// range; positions run 0 to length - 1 and skip deleted entries
+static int mapEntry(const char *name, int argCount, Value *args)
+{
+    if (argCount != 2 || !IS_MAP(args[0]) || !IS_NUMBER(args[1]))
+    {
+        nativeError("%s expects a map and a position.", name);
+        return -1;
+    }
+
+    ObjMap *map = AS_MAP(args[0]);
+    Table *table = &map->table;
+    double position = AS_NUMBER(args[1]);
+    if (position < 0 || position >= table->count || position != (int)position)
+    {
+        nativeError("%s position %g is out of range.", name, position);
+        return -1;
+    }
+
+    return tableSeek(table, &map->cursor, (int)position);
+}
+
+// position in a list or vector from a number, -1 unless it's a whole number from 0 to limit
+static int elementIndex(Value index, int limit)
+{
+    if (!IS_NUMBER(index))
+        return -1;
+
+    // written so nan fails the range check too
+    double number = AS_NUMBER(index);
+    if (!(number >= 0 && number <= limit) || number != (int)number)
+        return -1;
+
+    return (int)number;
+}
+
+// persistent map or vector, or a transient still in use
+static bool isCollection(Value value)
+{
+    return (IS_PERSISTENT_MAP(value) || IS_PERSISTENT_VECTOR(value)) && !isSpentTransient(AS_OBJ(value));
+}
+
+// persistent map or vector made by transient
+static bool isTransient(Value value)
+{
+    if (IS_PERSISTENT_MAP(value))
+        return AS_PERSISTENT_MAP(value)->isTransient;
+
+    return IS_PERSISTENT_VECTOR(value) && AS_PERSISTENT_VECTOR(value)->isTransient;
+}
+
+// persistentMap(key, value, ...): map of the pairs
+static Value persistentMapNative(int argCount, Value *args)
+{
+    if (argCount % 2 != 0)
+        return nativeError("persistentMap expects keys and values in pairs.");
+
+    // filled as a transient so the pairs don't copy each other's paths
+    ObjPersistentMap *map = (ObjPersistentMap *)transientOf((Obj *)newPersistentMap());
+    for (int i = 0; i < argCount; i += 2)
+        map = persistentMapPut(map, args[i], args[i + 1]);
+
+    return OBJ_VAL(persistentOf((Obj *)map));
+}
+
+// persistentVector(value, ...): vector of the arguments
+static Value persistentVectorNative(int argCount, Value *args)
+{
+    ObjPersistentVector *vector = (ObjPersistentVector *)transientOf((Obj *)newPersistentVector());
+    for (int i = 0; i < argCount; i++)
+        vector = persistentVectorPush(vector, args[i]);
+
+    return OBJ_VAL(persistentOf((Obj *)vector));
+}
+
+// put(collection, key, value): collection with key set, a vector
+// takes positions up to its length, the length appends
+static Value putNative(int argCount, Value *args)
+{
+    if (argCount != 3 || !isCollection(args[0]))
+        return nativeError("put expects a persistent map or vector, a key and a value.");
+
+    if (IS_PERSISTENT_MAP(args[0]))
+        return OBJ_VAL(persistentMapPut(AS_PERSISTENT_MAP(args[0]), args[1], args[2]));
+
+    ObjPersistentVector *vector = AS_PERSISTENT_VECTOR(args[0]);
+    int index = elementIndex(args[1], vector->count);
+    if (index < 0)
+        return nativeError("put position is out of range.");
+
+    if (index == vector->count)
+        return OBJ_VAL(persistentVectorPush(vector, args[2]));
+
+    return OBJ_VAL(persistentVectorSet(vector, index, args[2]));
+}
+
+// without(map, key): persistent map without the key
+static Value withoutNative(int argCount, Value *args)
+{
+    if (argCount != 2 || !IS_PERSISTENT_MAP(args[0]) || !isCollection(args[0]))
+        return nativeError("without expects a persistent map and a key.");
+
+    return OBJ_VAL(persistentMapRemove(AS_PERSISTENT_MAP(args[0]), args[1]));
+}
+
+// push(list, value): appends in place and returns the list,
+// push(vector, value): persistent vector with the value appended
+static Value pushNative(int argCount, Value *args)
+{
+    if (argCount == 2 && IS_LIST(args[0]))
+    {
+        listAppend(AS_LIST(args[0]), &args[1], 1);
+        return args[0];
+    }
+
+    if (argCount != 2 || !IS_PERSISTENT_VECTOR(args[0]) || !isCollection(args[0]))
+        return nativeError("push expects a list or persistent vector and a value.");
+
+    return OBJ_VAL(persistentVectorPush(AS_PERSISTENT_VECTOR(args[0]), args[1]));
+}
+
+// pop(list): removes and returns the last item,
+// pop(vector): persistent vector without its last value
+static Value popNative(int argCount, Value *args)
+{
+    if (argCount == 1 && IS_LIST(args[0]))
+    {
+        ValueArray *items = &AS_LIST(args[0])->items;
+        if (items->count == 0)
+            return nativeError("Can't pop an empty list.");
+
+        return items->values[--items->count];
+    }
+
+    if (argCount != 1 || !IS_PERSISTENT_VECTOR(args[0]) || !isCollection(args[0]))
+        return nativeError("pop expects a list or persistent vector.");
+
+    if (AS_PERSISTENT_VECTOR(args[0])->count == 0)
+        return nativeError("Can't pop an empty vector.");
+
+    return OBJ_VAL(persistentVectorPop(AS_PERSISTENT_VECTOR(args[0])));
+}
+
+// insert(list, index, value): put value at index, index may be the length
+static Value insertNative(int argCount, Value *args)
+{
+    if (argCount != 3 || !IS_LIST(args[0]))
+        return nativeError("insert expects a list, a position and a value.");
+
+    ObjList *list = AS_LIST(args[0]);
+    int index = elementIndex(args[1], list->items.count);
+    if (index < 0)
+        return nativeError("insert position is out of range.");
+
+    listInsert(list, index, args[2]);
+    return args[0];
+}
+
+// slice(list, start, end): new list of the items from start up to end
+static Value sliceNative(int argCount, Value *args)
+{
+    if (argCount != 3 || !IS_LIST(args[0]))
+        return nativeError("slice expects a list, a start and an end.");
+
+    ObjList *list = AS_LIST(args[0]);
+    int start = elementIndex(args[1], list->items.count);
+    int end = elementIndex(args[2], list->items.count);
+    if (start < 0 || end < start)
+        return nativeError("slice range is out of bounds.");
+
+    ObjList *slice = newList();
+    listAppend(slice, list->items.values + start, end - start);
+    return OBJ_VAL(slice);
+}
+
+// transient(collection): copy that put, without, push and pop change in place
+static Value transientNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !isCollection(args[0]) || isTransient(args[0]))
+        return nativeError("transient expects a persistent map or vector.");
+
+    return OBJ_VAL(transientOf(AS_OBJ(args[0])));
+}
+
+// persistent(transient): the transient's contents as a persistent collection
+static Value persistentNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !isCollection(args[0]) || !isTransient(args[0]))
+        return nativeError("persistent expects a transient map or vector.");
+
+    return OBJ_VAL(persistentOf(AS_OBJ(args[0])));
+}
+
+// keys(map): vector of a persistent map's keys
+static Value keysNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !IS_PERSISTENT_MAP(args[0]) || !isCollection(args[0]))
+        return nativeError("keys expects a persistent map.");
+
+    return OBJ_VAL(persistentMapKeys(AS_PERSISTENT_MAP(args[0])));
+}
+
+// values(map): vector of a persistent map's values, in the order of keys(map)
+static Value valuesNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !IS_PERSISTENT_MAP(args[0]) || !isCollection(args[0]))
+        return nativeError("values expects a persistent map.");
+
+    return OBJ_VAL(persistentMapValues(AS_PERSISTENT_MAP(args[0])));
+}
+
+// float64Array(length), float64Array(list of numbers) or
+// float64Array(array): new packed array of zeros or a copy
+static Value float64ArrayNative(int argCount, Value *args)
+{
+    if (argCount == 1 && IS_NUMBER(args[0]))
+    {
+        int count = elementIndex(args[0], INT32_MAX / (int)sizeof(double));
+        if (count < 0)
+            return nativeError("float64Array length must be a whole number.");
+
+        return OBJ_VAL(newFloat64Array(count));
+    }
+
+    if (argCount == 1 && IS_FLOAT64_ARRAY(args[0]))
+    {
+        ObjFloat64Array *from = AS_FLOAT64_ARRAY(args[0]);
+        ObjFloat64Array *array = newFloat64Array(from->count);
+        if (from->count > 0)
+            memcpy(array->values, from->values, sizeof(double) * from->count);
+
+        return OBJ_VAL(array);
+    }
+
+    if (argCount == 1 && IS_LIST(args[0]))
+    {
+        ValueArray *items = &AS_LIST(args[0])->items;
+        ObjFloat64Array *array = newFloat64Array(items->count);
+
+        for (int i = 0; i < items->count; i++)
+        {
+            if (!IS_NUMBER(items->values[i]))
+                return nativeError("float64Array list items must be numbers.");
+
+            array->values[i] = AS_NUMBER(items->values[i]);
+        }
+
+        return OBJ_VAL(array);
+    }
+
+    return nativeError("float64Array expects a length, a list or a Float64Array.");
+}
+
+// sum(array): total of the values
+static Value sumNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !IS_FLOAT64_ARRAY(args[0]))
+        return nativeError("sum expects a Float64Array.");
+
+    ObjFloat64Array *array = AS_FLOAT64_ARRAY(args[0]);
+    return NUMBER_VAL(sumDoubles(array->values, array->count));
+}
+
+// min(array): smallest value
+static Value minNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !IS_FLOAT64_ARRAY(args[0]))
+        return nativeError("min expects a Float64Array.");
+
+    ObjFloat64Array *array = AS_FLOAT64_ARRAY(args[0]);
+    if (array->count == 0)
+        return nativeError("min of an empty array.");
+
+    return NUMBER_VAL(minDoubles(array->values, array->count));
+}
+
+// max(array): largest value
+static Value maxNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !IS_FLOAT64_ARRAY(args[0]))
+        return nativeError("max expects a Float64Array.");
+
+    ObjFloat64Array *array = AS_FLOAT64_ARRAY(args[0]);
+    if (array->count == 0)
+        return nativeError("max of an empty array.");
+
+    return NUMBER_VAL(maxDoubles(array->values, array->count));
+}
+
+// dot(a, b): sum of the products of two arrays of the same length
+static Value dotNative(int argCount, Value *args)
+{
+    if (argCount != 2 || !IS_FLOAT64_ARRAY(args[0]) || !IS_FLOAT64_ARRAY(args[1]))
+        return nativeError("dot expects two Float64Arrays.");
+
+    ObjFloat64Array *a = AS_FLOAT64_ARRAY(args[0]);
+    ObjFloat64Array *b = AS_FLOAT64_ARRAY(args[1]);
+    if (a->count != b->count)
+        return nativeError("dot arrays have lengths %d and %d.", a->count, b->count);
+
+    return NUMBER_VAL(dotDoubles(a->values, b->values, a->count));
+}
+
+// scale(array, factor): multiplies every value in place, returns the array
+static Value scaleNative(int argCount, Value *args)
+{
+    if (argCount != 2 || !IS_FLOAT64_ARRAY(args[0]) || !IS_NUMBER(args[1]))
+        return nativeError("scale expects a Float64Array and a number.");
+
+    ObjFloat64Array *array = AS_FLOAT64_ARRAY(args[0]);
+    scaleDoubles(array->values, array->count, AS_NUMBER(args[1]));
+    return args[0];
+}
+
+// prefixSum(array): running totals in place, returns the array
+static Value prefixSumNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !IS_FLOAT64_ARRAY(args[0]))
+        return nativeError("prefixSum expects a Float64Array.");
+
+    ObjFloat64Array *array = AS_FLOAT64_ARRAY(args[0]);
+    prefixSumDoubles(array->values, array->count);
+    return args[0];
+}
+
+// keyAt(map, i): key of the i'th entry in insertion order
+static Value keyAtNative(int argCount, Value *args)
+{
+    int entry = mapEntry("keyAt", argCount, args);
+    if (entry < 0)
+        return NIL_VAL;
+
+    return AS_MAP(args[0])->table.keys[entry];
+}
+
+// valueAt(map, i): value of the i'th entry in insertion order
+static Value valueAtNative(int argCount, Value *args)
+{
+    int entry = mapEntry("valueAt", argCount, args);
+    if (entry < 0)
+        return NIL_VAL;
+
+    return AS_MAP(args[0])->table.values[entry];
+}
+
+// clear(builder): empty a string builder, keeping its storage
+static Value clearNative(int argCount, Value *args)
+{
+    if (argCount != 1 || !IS_STRING_BUILDER(args[0]))
+        return nativeError("clear expects a string builder.");
+
+    AS_STRING_BUILDER(args[0])->length = 0;
+    return args[0];
+}
+
+// toString(value): a string builder's contents, handing its buffer
+// over and leaving it empty; strings come back as they are
+static Value toStringNative(int argCount, Value *args)
+{
+    if (argCount != 1)
+        return nativeError("toString expects one argument.");
+
+    if (IS_STRING_BUILDER(args[0]))
+        return OBJ_VAL(builderFinish(AS_STRING_BUILDER(args[0])));
+
+    if (isText(args[0]))
+        return args[0];
+
+    if (IS_NUMBER(args[0]))
+    {
+        char buffer[NUMBER_BUFFER_SIZE];
+        int length = formatNumber(AS_NUMBER(args[0]), buffer);
+        return OBJ_VAL(copyString(buffer, length));
+    }
+
+    if (IS_BOOL(args[0]))
+    {
+        ObjString *string = AS_BOOL(args[0]) ? copyString("true", 4) : copyString("false", 5);
+        return OBJ_VAL(string);
+    }
+
+    if (IS_NIL(args[0]))
+        return OBJ_VAL(copyString("nil", 3));
+
+    return nativeError("toString can't convert this value.");
+}
+
 // config: point stackTop to the beginning
 static void resetStack()
 {
@@ -91,14 +716,45 @@ static void runtimeError(const char *format, ...)
         }
     }
 
-    CallFrame *frame = &vm.frames[vm.frameCount - 1];
-    size_t instruction = frame->ip - frame->function->chunk.code - 1;
-    int line = frame->function->chunk.lines[instruction];
-    fprintf(stderr, "[line %d] in script.\n", line);
+    // errors can also come from the compiler, before any call
+    if (vm.frameCount > 0)
+    {
+        CallFrame *frame = &vm.frames[vm.frameCount - 1];
+        size_t instruction = frame->ip - frame->function->chunk.code - 1;
+        int line = frame->function->chunk.lines[instruction];
+        fprintf(stderr, "[line %d] in script.\n", line);
+    }
 
     resetStack();
 }
 
+// an allocation failed or went over the memory limit, raise a runtime
+// error and unwind back to interpret instead of killing the host
+void outOfMemory(size_t bytes)
+{
+    if (!vm.canUnwind)
+    {
+        // nothing to unwind to, e.g. while setting up the vm
+        fprintf(stderr, "Out of memory allocating %zu bytes.\n", bytes);
+        exit(1);
+    }
+
+    runtimeError("Out of memory allocating %zu bytes (%zu in use).", bytes, vm.bytesAllocated);
+    longjmp(vm.errorJump, 1);
+}
+
+// natives fail by returning this, the error is raised once they return
+Value nativeError(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(vm.nativeMessage, sizeof(vm.nativeMessage), format, args);
+    va_end(args);
+
+    vm.nativeFailed = true;
+    return NIL_VAL;
+}
+
 // push a native function onto the stack
 static void defineNative(const char *name, NativeFunc function)
 {
@@ -109,26 +765,112 @@ static void defineNative(const char *name, NativeFunc function)
     pop();
 }
 
-// set up vm
+// set up vm with realloc and free
 void initVM()
 {
+    Allocator allocator = {defaultReallocate, NULL, NULL};
+    initVMWithAllocator(allocator);
+}
+
+// set up vm, every allocation goes through the given allocator
+void initVMWithAllocator(Allocator allocator)
+{
+    vm.allocator = allocator;
+    vm.bytesAllocated = 0;
+    vm.memoryLimit = 0;
+    vm.canUnwind = false;
+    vm.nativeFailed = false;
     resetStack();
-    vm.objects = NULL;
+    initHeap(&vm.heap);
+    vm.code = NULL;
+    vm.sources = NULL;
     initTable(&vm.globals);
-    initTable(&vm.strings);
+    initInternSet(&vm.strings);
 
     // define more native funcs
     defineNative("clock", clockNative);
     defineNative("printFile", printFileNative);
+    defineNative("substr", substrNative);
+    defineNative("indexOf", indexOfNative);
+    defineNative("split", splitNative);
+    defineNative("stringBuilder", stringBuilderNative);
+    defineNative("append", appendNative);
+    defineNative("length", lengthNative);
+    defineNative("clear", clearNative);
+    defineNative("toString", toStringNative);
+    defineNative("hasKey", hasKeyNative);
+    defineNative("remove", removeNative);
+    defineNative("keyAt", keyAtNative);
+    defineNative("valueAt", valueAtNative);
+    defineNative("persistentMap", persistentMapNative);
+    defineNative("persistentVector", persistentVectorNative);
+    defineNative("put", putNative);
+    defineNative("without", withoutNative);
+    defineNative("push", pushNative);
+    defineNative("pop", popNative);
+    defineNative("transient", transientNative);
+    defineNative("persistent", persistentNative);
+    defineNative("keys", keysNative);
+    defineNative("values", valuesNative);
+    defineNative("insert", insertNative);
+    defineNative("slice", sliceNative);
+    defineNative("float64Array", float64ArrayNative);
+    defineNative("sum", sumNative);
+    defineNative("min", minNative);
+    defineNative("max", maxNative);
+    defineNative("dot", dotNative);
+    defineNative("scale", scaleNative);
+    defineNative("prefixSum", prefixSumNative);
 }
 
 // clear vm
 // todo: finish function
 void freeVM()
 {
+    if (vm.allocator.freeAll != NULL)
+    {
+        // the allocator drops everything at once, just forget it
+        vm.allocator.freeAll(vm.allocator.userData);
+        initTable(&vm.globals);
+        initInternSet(&vm.strings);
+        initHeap(&vm.heap);
+        vm.code = NULL;
+        vm.sources = NULL;
+        vm.bytesAllocated = 0;
+        return;
+    }
+
+#ifdef DEBUG_TABLE_STATS
+    printTableStats("globals", &vm.globals);
+#endif
+
     freeTable(&vm.globals);
-    freeTable(&vm.strings);
+    freeInternSet(&vm.strings);
     freeObjects();
+
+    CodeSegment *segment = vm.code;
+    while (segment != NULL)
+    {
+        CodeSegment *next = segment->next;
+        freeCodeSegment(segment);
+        segment = next;
+    }
+    vm.code = NULL;
+
+    Source *source = vm.sources;
+    while (source != NULL)
+    {
+        Source *next = source->next;
+        reallocate(source, sizeof(Source) + source->length + 1, 0);
+        source = next;
+    }
+    vm.sources = NULL;
+}
+
+// cap the vm's memory, 0 removes the cap
+void setMemoryLimit(size_t bytes)
+{
+    vm.memoryLimit = bytes;
 }
 
 // append value
@@ -176,6 +918,14 @@ static bool call(ObjFunction *function, int argCount)
     return true;
 }
 
+// a value kept anywhere besides its stack slot, an array result
+// stored like this can't be written over by the next operator
+static inline void escapeValue(Value value)
+{
+    if (IS_FLOAT64_ARRAY(value))
+        AS_FLOAT64_ARRAY(value)->temporarySlot = -1;
+}
+
 // errors if not a function?
 static bool callValue(Value callee, int argCount)
 {
@@ -188,7 +938,21 @@ static bool callValue(Value callee, int argCount)
         case OBJ_NATIVE:
         {
             NativeFunc native = AS_NATIVE(callee);
+
+            // natives may keep their arguments
+            for (int i = 0; i < argCount; i++)
+                escapeValue(vm.stackTop[i - argCount]);
+
             Value result = native(argCount, vm.stackTop - argCount);
+
+            // native reported an error with nativeError
+            if (vm.nativeFailed)
+            {
+                vm.nativeFailed = false;
+                runtimeError("%s", vm.nativeMessage);
+                return false;
+            }
+
             vm.stackTop -= argCount + 1;
             push(result);
             return true;
@@ -209,26 +973,308 @@ static bool isFalsey(Value value)
     return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
 }
 
-// join strings
+// join strings or ropes, long results become ropes so
+// building a string in a loop doesn't copy it every time
 // todo: move this
 static void concatenate()
 {
-    ObjString *b = AS_STRING(pop());
-    ObjString *a = AS_STRING(pop());
+    Obj *b = AS_OBJ(pop());
+    Obj *a = AS_OBJ(pop());
+
+    int aLength = textLength(a);
+    int bLength = textLength(b);
 
-    int length = a->length + b->length;
+    // nothing to join
+    if (aLength == 0 || bLength == 0)
+    {
+        Obj *result = aLength == 0 ? b : a;
+        push(OBJ_VAL(result));
+        return;
+    }
+
+    if (aLength + bLength >= ROPE_MIN_LENGTH)
+    {
+        push(OBJ_VAL(newRope(a, b)));
+        return;
+    }
 
-    char *newString = ALLOCATE(char, length + 1);
+    // short halves are never ropes,
+    // build the result directly in its final object
+    ObjString *result = allocateString(aLength + bLength);
 
     // first copy a
-    memcpy(newString, a->chars, a->length);
+    memcpy(result->chars, textChars(a), aLength);
 
     // then copy b, a.length away from first space
-    memcpy(newString + a->length, b->chars, b->length);
-    newString[length] = '\0';
+    memcpy(result->chars + aLength, textChars(b), bLength);
+
+    // not hashed or interned until something needs it
+    push(OBJ_VAL(result));
+}
+
+// a op b element by element: a float64 array on one side and an array
+// of the same length or a number on the other; the result reuses an
+// operand that is an earlier result of the same expression, so a chain
+// like a * b + c allocates once
+static bool arrayArithmetic(KernelOp op)
+{
+    Value a = peek(1);
+    Value b = peek(0);
+    bool aIsArray = IS_FLOAT64_ARRAY(a);
+    bool bIsArray = IS_FLOAT64_ARRAY(b);
+
+    if ((!aIsArray && !IS_NUMBER(a)) || (!bIsArray && !IS_NUMBER(b)))
+    {
+        runtimeError("Operands must be numbers or Float64Arrays.");
+        return false;
+    }
+
+    // a number is a one value operand with a step of 0
+    double aNumber = aIsArray ? 0 : AS_NUMBER(a);
+    double bNumber = bIsArray ? 0 : AS_NUMBER(b);
+    const double *aValues = aIsArray ? AS_FLOAT64_ARRAY(a)->values : &aNumber;
+    const double *bValues = bIsArray ? AS_FLOAT64_ARRAY(b)->values : &bNumber;
+    int count = aIsArray ? AS_FLOAT64_ARRAY(a)->count : AS_FLOAT64_ARRAY(b)->count;
+
+    if (aIsArray && bIsArray && AS_FLOAT64_ARRAY(a)->count != AS_FLOAT64_ARRAY(b)->count)
+    {
+        runtimeError("Float64Array lengths %d and %d don't match.",
+                     AS_FLOAT64_ARRAY(a)->count, AS_FLOAT64_ARRAY(b)->count);
+        return false;
+    }
+
+    int slot = (int)(vm.stackTop - vm.stack) - 2;
+    ObjFloat64Array *result;
+
+    if (aIsArray && AS_FLOAT64_ARRAY(a)->temporarySlot == slot)
+        result = AS_FLOAT64_ARRAY(a);
+    else if (bIsArray && AS_FLOAT64_ARRAY(b)->temporarySlot == slot + 1)
+        result = AS_FLOAT64_ARRAY(b);
+    else
+        result = newFloat64Array(count);
+
+    elementwiseDoubles(op, result->values, aValues, aIsArray, bValues, bIsArray, count);
+    result->temporarySlot = slot;
 
-    ObjString *result = takeString(newString, length);
+    vm.stackTop -= 2;
     push(OBJ_VAL(result));
+    return true;
+}
+
+// target[key], missing map keys read as nil
+static bool getIndex(Value target, Value key, Value *value)
+{
+    if (IS_LIST(target))
+    {
+        ObjList *list = AS_LIST(target);
+        int index = elementIndex(key, list->items.count - 1);
+        if (index < 0)
+        {
+            runtimeError("List index out of range.");
+            return false;
+        }
+
+        *value = list->items.values[index];
+        return true;
+    }
+
+    if (IS_FLOAT64_ARRAY(target))
+    {
+        ObjFloat64Array *array = AS_FLOAT64_ARRAY(target);
+        int index = elementIndex(key, array->count - 1);
+        if (index < 0)
+        {
+            runtimeError("Float64Array index out of range.");
+            return false;
+        }
+
+        *value = NUMBER_VAL(array->values[index]);
+        return true;
+    }
+
+    if (IS_MAP(target))
+    {
+        if (!tableGetValue(&AS_MAP(target)->table, key, value))
+            *value = NIL_VAL;
+        return true;
+    }
+
+    if (!isCollection(target))
+    {
+        runtimeError(isTransient(target) ? "Transient used after it was made persistent."
+                                         : "Only lists, arrays, maps and vectors can be indexed.");
+        return false;
+    }
+
+    if (IS_PERSISTENT_MAP(target))
+    {
+        if (!persistentMapGet(AS_PERSISTENT_MAP(target), key, value))
+            *value = NIL_VAL;
+        return true;
+    }
+
+    ObjPersistentVector *vector = AS_PERSISTENT_VECTOR(target);
+    int index = elementIndex(key, vector->count - 1);
+    if (index < 0)
+    {
+        runtimeError("Vector index out of range.");
+        return false;
+    }
+
+    *value = persistentVectorGet(vector, index);
+    return true;
+}
+
+// target[key] = value, persistent collections only change through transients
+static bool setIndex(Value target, Value key, Value value)
+{
+    if (IS_LIST(target))
+    {
+        ObjList *list = AS_LIST(target);
+        int index = elementIndex(key, list->items.count - 1);
+        if (index < 0)
+        {
+            runtimeError("List index out of range.");
+            return false;
+        }
+
+        list->items.values[index] = value;
+        return true;
+    }
+
+    if (IS_FLOAT64_ARRAY(target))
+    {
+        ObjFloat64Array *array = AS_FLOAT64_ARRAY(target);
+        int index = elementIndex(key, array->count - 1);
+        if (index < 0)
+        {
+            runtimeError("Float64Array index out of range.");
+            return false;
+        }
+
+        if (!IS_NUMBER(value))
+        {
+            runtimeError("Float64Array items must be numbers.");
+            return false;
+        }
+
+        array->values[index] = AS_NUMBER(value);
+        return true;
+    }
+
+    if (IS_MAP(target))
+    {
+        tableSetValue(&AS_MAP(target)->table, key, value);
+        return true;
+    }
+
+    if (!isCollection(target))
+    {
+        runtimeError(isTransient(target) ? "Transient used after it was made persistent."
+                                         : "Only lists, arrays, maps and vectors can be indexed.");
+        return false;
+    }
+
+    if (!isTransient(target))
+    {
+        runtimeError("Persistent collections can't change in place, use put or a transient.");
+        return false;
+    }
+
+    if (IS_PERSISTENT_MAP(target))
+    {
+        persistentMapPut(AS_PERSISTENT_MAP(target), key, value);
+        return true;
+    }
+
+    // the length appends, like put
+    ObjPersistentVector *vector = AS_PERSISTENT_VECTOR(target);
+    int index = elementIndex(key, vector->count);
+    if (index < 0)
+    {
+        runtimeError("Vector index out of range.");
+        return false;
+    }
+
+    if (index == vector->count)
+        persistentVectorPush(vector, value);
+    else
+        persistentVectorSet(vector, index, value);
+    return true;
+}
+
+// chars of an interpolated part that isn't a number,
+// NULL if the part can't be interpolated
+static const char *partChars(Value part, int *length)
+{
+    if (isText(part))
+    {
+        *length = textLength(AS_OBJ(part));
+        return textChars(AS_OBJ(part));
+    }
+
+    if (IS_BOOL(part))
+    {
+        *length = AS_BOOL(part) ? 4 : 5;
+        return AS_BOOL(part) ? "true" : "false";
+    }
+
+    if (IS_NIL(part))
+    {
+        *length = 3;
+        return "nil";
+    }
+
+    return NULL;
+}
+
+// join the parts of an interpolated string, the result is sized
+// once and filled in place; numbers are formatted once to learn
+// their length and again straight into the result
+static bool buildString(int count)
+{
+    Value *parts = vm.stackTop - count;
+
+    char number[NUMBER_BUFFER_SIZE];
+    int length = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        int partLength;
+
+        if (IS_NUMBER(parts[i]))
+            partLength = formatNumber(AS_NUMBER(parts[i]), number);
+        else if (partChars(parts[i], &partLength) == NULL)
+        {
+            runtimeError("Only strings, numbers, booleans and nil can be interpolated.");
+            return false;
+        }
+
+        length += partLength;
+    }
+
+    ObjString *result = allocateString(length);
+
+    char *dest = result->chars;
+    for (int i = 0; i < count; i++)
+    {
+        // a number's null terminator lands on the next part's
+        // first char or the result's own terminator
+        if (IS_NUMBER(parts[i]))
+        {
+            dest += formatNumber(AS_NUMBER(parts[i]), dest);
+            continue;
+        }
+
+        int partLength;
+        const char *chars = partChars(parts[i], &partLength);
+        memcpy(dest, chars, partLength);
+        dest += partLength;
+    }
+
+    vm.stackTop -= count;
+    push(OBJ_VAL(takeString(result)));
+    return true;
 }
 
 // START OF THE RUN PROGRAM
@@ -330,6 +1376,7 @@ static InterpretResult run()
         case OP_SET_LOCAL:
         {
             uint8_t slot = READ_BYTE();
+            escapeValue(peek(0));
             frame->slots[slot] = peek(0);
             break;
         }
@@ -351,6 +1398,7 @@ static InterpretResult run()
         {
             // places variable from constants into global table
             ObjString *varName = READ_STRING();
+            escapeValue(peek(0));
             tableSet(&vm.globals, varName, peek(0));
             pop();
             break;
@@ -358,6 +1406,7 @@ static InterpretResult run()
         case OP_SET_GLOBAL:
         {
             ObjString *name = READ_STRING();
+            escapeValue(peek(0));
 
             if (tableSet(&vm.globals, name, peek(0)))
             {
@@ -390,7 +1439,7 @@ static InterpretResult run()
         // binary ops, arithametic
         case OP_ADD:
         {
-            if (IS_STRING(peek(0)) && IS_STRING(peek(1)))
+            if (isText(peek(0)) && isText(peek(1)))
             {
                 concatenate();
             }
@@ -401,6 +1450,11 @@ static InterpretResult run()
                 double a = AS_NUMBER(pop());
                 push(NUMBER_VAL(a + b));
             }
+            else if (IS_FLOAT64_ARRAY(peek(0)) || IS_FLOAT64_ARRAY(peek(1)))
+            {
+                if (!arrayArithmetic(KERNEL_ADD))
+                    return INTERPRET_RUNTIME_ERROR;
+            }
             else
             {
                 runtimeError("Values must be two strings or numbers.");
@@ -410,16 +1464,37 @@ static InterpretResult run()
         }
         case OP_SUBTRACT:
         {
+            if (IS_FLOAT64_ARRAY(peek(0)) || IS_FLOAT64_ARRAY(peek(1)))
+            {
+                if (!arrayArithmetic(KERNEL_SUBTRACT))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+
             BINARY_OP(NUMBER_VAL, -);
             break;
         }
         case OP_MULTIPLY:
         {
+            if (IS_FLOAT64_ARRAY(peek(0)) || IS_FLOAT64_ARRAY(peek(1)))
+            {
+                if (!arrayArithmetic(KERNEL_MULTIPLY))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+
             BINARY_OP(NUMBER_VAL, *);
             break;
         }
         case OP_DIVIDE:
         {
+            if (IS_FLOAT64_ARRAY(peek(0)) || IS_FLOAT64_ARRAY(peek(1)))
+            {
+                if (!arrayArithmetic(KERNEL_DIVIDE))
+                    return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+
             BINARY_OP(NUMBER_VAL, /);
             break;
         }
@@ -431,6 +1506,11 @@ static InterpretResult run()
                 double a = AS_NUMBER(pop());
                 push(NUMBER_VAL(pow(a, b)));
             }
+            else if (IS_FLOAT64_ARRAY(peek(0)) || IS_FLOAT64_ARRAY(peek(1)))
+            {
+                if (!arrayArithmetic(KERNEL_POWER))
+                    return INTERPRET_RUNTIME_ERROR;
+            }
             else
             {
                 runtimeError("Values must be numbers.");
@@ -465,6 +1545,133 @@ static InterpretResult run()
             printlnValue(pop());
             break;
         }
+        case OP_BUILD_STRING:
+        {
+            if (!buildString(READ_BYTE()))
+                return INTERPRET_RUNTIME_ERROR;
+            break;
+        }
+        case OP_MAP:
+        {
+            push(OBJ_VAL(newMap()));
+            break;
+        }
+        case OP_MAP_ADD:
+        {
+            // key value pairs sit on the stack above the map
+            int count = READ_BYTE();
+            Value *pairs = vm.stackTop - count * 2;
+            Table *table = &AS_MAP(pairs[-1])->table;
+
+            for (int i = 0; i < count; i++)
+            {
+                escapeValue(pairs[i * 2]);
+                escapeValue(pairs[i * 2 + 1]);
+                tableSetValue(table, pairs[i * 2], pairs[i * 2 + 1]);
+            }
+
+            vm.stackTop = pairs;
+            break;
+        }
+        case OP_LIST:
+        {
+            push(OBJ_VAL(newList()));
+            break;
+        }
+        case OP_LIST_ADD:
+        {
+            // elements sit on the stack above the list, copied in one go
+            int count = READ_BYTE();
+            Value *items = vm.stackTop - count;
+            for (int i = 0; i < count; i++)
+                escapeValue(items[i]);
+
+            listAppend(AS_LIST(items[-1]), items, count);
+
+            vm.stackTop = items;
+            break;
+        }
+        case OP_GET_INDEX:
+        {
+            // whole number list indexes are read right here, anything else
+            // goes through getIndex which also reports the errors
+            if (IS_LIST(peek(1)) && IS_NUMBER(peek(0)))
+            {
+                ValueArray *items = &AS_LIST(peek(1))->items;
+                double number = AS_NUMBER(peek(0));
+
+                if (number >= 0 && number < items->count && number == (int)number)
+                {
+                    vm.stackTop -= 2;
+                    push(items->values[(int)number]);
+                    break;
+                }
+            }
+
+            // float64 arrays load the raw double
+            if (IS_FLOAT64_ARRAY(peek(1)) && IS_NUMBER(peek(0)))
+            {
+                ObjFloat64Array *array = AS_FLOAT64_ARRAY(peek(1));
+                double number = AS_NUMBER(peek(0));
+
+                if (number >= 0 && number < array->count && number == (int)number)
+                {
+                    vm.stackTop -= 2;
+                    push(NUMBER_VAL(array->values[(int)number]));
+                    break;
+                }
+            }
+
+            Value value;
+            if (!getIndex(peek(1), peek(0), &value))
+                return INTERPRET_RUNTIME_ERROR;
+
+            vm.stackTop -= 2;
+            push(value);
+            break;
+        }
+        case OP_SET_INDEX:
+        {
+            // assignment evaluates to the value
+            Value value = peek(0);
+            escapeValue(peek(1));
+            escapeValue(value);
+
+            if (IS_LIST(peek(2)) && IS_NUMBER(peek(1)))
+            {
+                ValueArray *items = &AS_LIST(peek(2))->items;
+                double number = AS_NUMBER(peek(1));
+
+                if (number >= 0 && number < items->count && number == (int)number)
+                {
+                    items->values[(int)number] = value;
+                    vm.stackTop -= 3;
+                    push(value);
+                    break;
+                }
+            }
+
+            if (IS_FLOAT64_ARRAY(peek(2)) && IS_NUMBER(peek(1)) && IS_NUMBER(value))
+            {
+                ObjFloat64Array *array = AS_FLOAT64_ARRAY(peek(2));
+                double number = AS_NUMBER(peek(1));
+
+                if (number >= 0 && number < array->count && number == (int)number)
+                {
+                    array->values[(int)number] = AS_NUMBER(value);
+                    vm.stackTop -= 3;
+                    push(value);
+                    break;
+                }
+            }
+
+            if (!setIndex(peek(2), peek(1), value))
+                return INTERPRET_RUNTIME_ERROR;
+
+            vm.stackTop -= 3;
+            push(value);
+            break;
+        }
         case OP_JUMP:
         {
             uint16_t offset = READ_SHORT();
@@ -496,7 +1703,9 @@ static InterpretResult run()
         // eof, program, function
         case OP_RETURN:
         {
+            // the result lands in the caller's slots
             Value value = pop();
+            escapeValue(value);
             vm.frameCount--;
 
             if (vm.frameCount == 0)
@@ -520,20 +1729,69 @@ static InterpretResult run()
 #undef BINARY_OP
 }
 
-// compile source to byte code
-InterpretResult interpret(const char *source)
+// source buffer owned by the vm, freed along with it
+char *newSource(size_t length)
 {
-    // compile source code, get top level code/function
-    ObjFunction *function = compile(source);
+    Source *source = (Source *)reallocate(NULL, 0, sizeof(Source) + length + 1);
+    source->length = length;
+    source->text[length] = '\0';
+
+    source->next = vm.sources;
+    vm.sources = source;
+
+    return source->text;
+}
+
+// string literals point into the source so it has to outlive
+// the program, borrowed ones are copied into a vm owned buffer
+static const char *copySource(const char *source)
+{
+    size_t length = strlen(source);
+    char *copy = newSource(length);
+    memcpy(copy, source, length);
+    return copy;
+}
+
+// compile source to byte code, copying it first unless the vm owns it
+static InterpretResult execute(const char *source, bool isOwned)
+{
+    // running out of memory anywhere below lands here
+    if (setjmp(vm.errorJump) != 0)
+    {
+        vm.canUnwind = false;
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    vm.canUnwind = true;
+
+    // compile source code, get top level code/function; source isn't
+    // reassigned after setjmp so a jump back can't clobber it
+    ObjFunction *function = compile(isOwned ? source : copySource(source));
 
     // if null, there was a compile time error and we
     // dont have a starting place for the code
     if (function == NULL)
+    {
+        vm.canUnwind = false;
         return INTERPRET_COMPILE_ERROR;
+    }
 
     // begin executing
     call(function, 0);
 
     // run code
-    return run();
+    InterpretResult result = run();
+    vm.canUnwind = false;
+    return result;
+}
+
+// compile a copy of source to byte code
+InterpretResult interpret(const char *source)
+{
+    return execute(source, false);
+}
+
+// compile a buffer from newSource in place
+InterpretResult interpretSource(const char *source)
+{
+    return execute(source, true);
 }
\ No newline at end of file
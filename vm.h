@@ -1,7 +1,10 @@
 #ifndef blue_vm_h
 #define blue_vm_h
 
+#include <setjmp.h>
+
 #include "chunk.h"
+#include "memory.h"
 #include "object.h"
 #include "table.h"
 #include "value.h"
@@ -23,6 +26,14 @@ typedef struct
     Value *slots;
 } CallFrame;
 
+// source text kept until the vm is freed, string literals point into it
+typedef struct Source
+{
+    struct Source *next;
+    size_t length;
+    char text[];
+} Source;
+
 typedef struct
 {
     // visualize a function-call stack
@@ -45,11 +56,32 @@ typedef struct
     // global variables
     Table globals;
 
-    // hash of all strings
-    Table strings;
+    // every interned string, never removed until freeVM
+    InternSet strings;
+
+    // every object, in typed pages
+    Heap heap;
+
+    // packed bytecode of everything compiled
+    CodeSegment *code;
+
+    // every source compiled
+    Source *sources;
+
+    // where all of the vm's memory comes from
+    Allocator allocator;
+
+    // bytes currently allocated and the most the vm may hold, 0 is unlimited
+    size_t bytesAllocated;
+    size_t memoryLimit;
 
-    // linked list of all objects
-    Obj *objects;
+    // error a native reported, raised when it returns
+    bool nativeFailed;
+    char nativeMessage[256];
+
+    // where an out of memory error unwinds to while interpreting
+    jmp_buf errorJump;
+    bool canUnwind;
 } VM;
 
 typedef enum
@@ -65,12 +97,31 @@ extern VM vm;
 // config vm
 void initVM();
 
+// config vm to take all of its memory from an embedder's allocator
+void initVMWithAllocator(Allocator allocator);
+
 // clear vm contents
 void freeVM();
 
-// interpret code
+// cap how many bytes the vm may allocate, 0 removes the cap
+void setMemoryLimit(size_t bytes);
+
+// buffer for length chars of source the vm owns, fill it and pass it
+// to interpretSource to skip the copy interpret makes
+char *newSource(size_t length);
+
+// interpret code, the source is copied so the caller can free it
 InterpretResult interpret(const char *source);
 
+// interpret code in a buffer from newSource without copying it
+InterpretResult interpretSource(const char *source);
+
+// natives return this to raise a runtime error
+Value nativeError(const char *format, ...);
+
+// report an allocation that can't be satisfied, unwinds out of interpret
+void outOfMemory(size_t bytes);
+
 // append value
 void push(Value value);
 